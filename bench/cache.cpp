@@ -0,0 +1,172 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+// Compares the disk cache encodings on a synthetic corpus of preview sized
+// images: the extension preserving cache (PNG or JPEG, written with vips
+// defaults like LibvipsImage::save_to_cache), QOI and raw pixels.
+
+#include "image/qoi.hpp"
+
+#include <vips/vips.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <print>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+constexpr int images = 24;
+constexpr int width = 640;
+constexpr int height = 480;
+constexpr int rounds = 5;
+
+struct Image {
+    std::vector<std::uint8_t> pixels;
+    int channels = 0;
+};
+
+// gradients with sensor like noise and a few flat shapes, every other image has alpha
+auto make_corpus() -> std::vector<Image>
+{
+    std::mt19937 rng{42};
+    std::normal_distribution<float> noise{0.0F, 3.0F};
+    std::vector<Image> corpus;
+    for (int n = 0; n < images; ++n) {
+        Image image{.pixels = {}, .channels = n % 2 == 0 ? 3 : 4};
+        image.pixels.resize(static_cast<std::size_t>(width) * height * image.channels);
+        auto *dst = image.pixels.data();
+        const float phase = static_cast<float>(n) * 0.7F;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x, dst += image.channels) {
+                const bool in_shape = ((x / 80) + (y / 60) + n) % 7 == 0;
+                for (int c = 0; c < 3; ++c) {
+                    const float wave = std::sin((static_cast<float>(x + (c * 40)) * 0.01F) + phase) *
+                                       std::cos(static_cast<float>(y) * 0.013F);
+                    const float value =
+                        in_shape ? 40.0F * static_cast<float>(c + 1) : 128.0F + (100.0F * wave) + noise(rng);
+                    dst[c] = static_cast<std::uint8_t>(std::clamp(value, 0.0F, 255.0F));
+                }
+                if (image.channels == 4) {
+                    dst[3] = x < width / 8 ? static_cast<std::uint8_t>(x * 255 / (width / 8)) : 255;
+                }
+            }
+        }
+        corpus.push_back(std::move(image));
+    }
+    return corpus;
+}
+
+auto encode_vips(const Image &image, const char *suffix) -> std::vector<std::uint8_t>
+{
+    VipsImage *in = vips_image_new_from_memory(image.pixels.data(), image.pixels.size(), width, height,
+                                               image.channels, VIPS_FORMAT_UCHAR);
+    void *buffer = nullptr;
+    std::size_t size = 0;
+    vips_image_write_to_buffer(in, suffix, &buffer, &size, nullptr);
+    g_object_unref(in);
+    std::vector<std::uint8_t> result(static_cast<std::uint8_t *>(buffer), static_cast<std::uint8_t *>(buffer) + size);
+    g_free(buffer);
+    return result;
+}
+
+// a cache hit with the image format, the decoded pixels still need the swizzle pass afterwards
+auto decode_vips(std::span<const std::uint8_t> data, std::span<std::uint8_t> out) -> bool
+{
+    VipsImage *image = vips_image_new_from_buffer(data.data(), data.size(), "", "access", VIPS_ACCESS_SEQUENTIAL,
+                                                  nullptr);
+    if (image == nullptr) {
+        return false;
+    }
+    std::size_t size = 0;
+    void *pixels = vips_image_write_to_memory(image, &size);
+    g_object_unref(image);
+    if (pixels == nullptr) {
+        return false;
+    }
+    std::memcpy(out.data(), pixels, std::min(size, out.size()));
+    g_free(pixels);
+    return true;
+}
+
+using Encoder = std::function<std::vector<std::uint8_t>(const Image &)>;
+using Decoder = std::function<bool(std::span<const std::uint8_t>, std::span<std::uint8_t>)>;
+
+void measure(std::string_view name, const std::vector<Image> &corpus, const Encoder &encode, const Decoder &decode)
+{
+    using clock = std::chrono::steady_clock;
+    std::vector<std::vector<std::uint8_t>> encoded;
+    std::size_t disk = 0;
+    std::size_t pixels = 0;
+    for (const auto &image : corpus) {
+        encoded.push_back(encode(image));
+        disk += encoded.back().size();
+        pixels += image.pixels.size();
+    }
+    std::vector<std::uint8_t> out(static_cast<std::size_t>(width) * height * 4);
+    std::size_t decoded = 0;
+    const auto start = clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (const auto &data : encoded) {
+            decoded += decode(data, out) ? 1 : 0;
+        }
+    }
+    const std::chrono::duration<double, std::micro> elapsed = clock::now() - start;
+    std::println("{:<8}{:>10.1f} us/image{:>10.1f} KiB/image{:>8.1f}% of raw", name,
+                 elapsed.count() / static_cast<double>(decoded), static_cast<double>(disk) / 1024.0 / images,
+                 100.0 * static_cast<double>(disk) / static_cast<double>(pixels));
+}
+
+} // namespace
+
+auto main(int /*argc*/, char *argv[]) -> int
+{
+    if (VIPS_INIT(argv[0]) != 0) {
+        vips_error_exit(nullptr);
+    }
+    vips_cache_set_max(0);
+    const auto corpus = make_corpus();
+    std::println("{} images of {}x{}, rgb and rgba", images, width, height);
+
+    measure("png", corpus, [](const Image &image) { return encode_vips(image, ".png"); }, decode_vips);
+    measure("jpeg", corpus, [](const Image &image) { return encode_vips(image, ".jpg"); }, decode_vips);
+    measure(
+        "qoi", corpus,
+        [](const Image &image) { return upp::qoi::encode(image.pixels, width, height, image.channels); },
+        [](std::span<const std::uint8_t> data, std::span<std::uint8_t> out) {
+            return upp::qoi::decode(data, out).has_value();
+        });
+    // a raw hit is an mmap, a copy is the upper bound of its cost
+    measure(
+        "raw", corpus, [](const Image &image) { return image.pixels; },
+        [](std::span<const std::uint8_t> data, std::span<std::uint8_t> out) {
+            std::memcpy(out.data(), data.data(), data.size());
+            return true;
+        });
+    vips_shutdown();
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "command/command.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+constexpr int rounds = 50;
+constexpr int commands_per_round = 2000;
+
+auto make_corpus() -> std::vector<std::string>
+{
+    std::vector<std::string> corpus;
+    corpus.reserve(commands_per_round);
+    for (int i = 0; i < commands_per_round; ++i) {
+        if (i % 2 == 0) {
+            // quoted numbers, as sent by most shell clients
+            corpus.push_back(std::format(
+                R"({{"action":"add","identifier":"preview","x":"{}","y":"{}","max_width":"80","max_height":"40",)"
+                R"("path":"/home/user/Pictures/photos/2024/{}.jpg"}})",
+                i % 200, i % 60, i));
+        } else {
+            corpus.push_back(std::format(
+                R"({{"action": "add", "identifier": "preview", "x": {}, "y": {}, "width": 80, "height": 40, )"
+                R"("scaler": "contain", "path": "/home/user/Pictures/photos/2024/{}.png"}})",
+                i % 200, i % 60, i));
+        }
+    }
+    return corpus;
+}
+
+template <typename Func>
+void measure(std::string_view name, Func func)
+{
+    using clock = std::chrono::steady_clock;
+    std::size_t parsed = 0;
+    const auto start = clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        parsed += func();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+    std::println("{:<32}{:>10.1f} ns/command", name, elapsed.count() / static_cast<double>(parsed));
+}
+
+} // namespace
+
+auto main() -> int
+{
+    using upp::Command;
+    const auto corpus = make_corpus();
+    std::string buffer;
+    for (const auto &line : corpus) {
+        buffer.append(line).push_back('\n');
+    }
+
+    measure("Command::from_json_generic", [&corpus] {
+        std::size_t parsed = 0;
+        for (const auto &line : corpus) {
+            parsed += Command::from_json_generic(line).has_value() ? 1 : 0;
+        }
+        return parsed;
+    });
+    measure("Command::from_json", [&corpus] {
+        std::size_t parsed = 0;
+        for (const auto &line : corpus) {
+            parsed += Command::from_json(line).has_value() ? 1 : 0;
+        }
+        return parsed;
+    });
+    measure("Command::from_json_lines", [&buffer] {
+        std::size_t parsed = 0;
+        for (const auto &cmd : Command::from_json_lines(buffer)) {
+            parsed += cmd.has_value() ? 1 : 0;
+        }
+        return parsed;
+    });
+    return 0;
+}
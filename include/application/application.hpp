@@ -23,14 +23,21 @@
 #include "cli.hpp"
 #include "command/command.hpp"
 #include "command/listener.hpp"
+#include "command/response.hpp"
+#include "command/scheduler.hpp"
+#include "image/cache_maintenance.hpp"
+#include "image/decode_pool.hpp"
 #include "log.hpp"
 #include "util/result.hpp"
 #include "util/thread.hpp"
 
 #include <CLI/CLI.hpp>
 
-#include <atomic>
+#include <future>
+#include <list>
 #include <memory>
+#include <optional>
+#include <vector>
 
 namespace upp
 {
@@ -46,28 +53,53 @@ class Application
     static void signal_handler(int signal);
     static void sigwinch_handler(int signal);
 
-    inline static std::atomic_flag stop_flag = ATOMIC_FLAG_INIT;
-
   private:
+    // a command whose images are being decoded, applied to the canvas once all are ready
+    struct InFlight {
+        Command cmd;
+        Clock::time_point started{};
+        // one per command, or per child for batches, invalid for commands without an image
+        std::vector<std::future<Decoded>> decodes{};
+    };
+
     Cli *cli;
     std::shared_ptr<ApplicationContext> ctx{ApplicationContext::get()};
-    CommandQueue queue;
+    CommandQueue queue{cli->layer.queue_capacity, CommandListener::reserved_cells};
+    CommandScheduler scheduler{
+        [this](const Command &cmd, Status status) { command_listener.respond_dropped(cmd, status); }};
     CommandListener command_listener{&queue};
+    // decodes wake the command thread through the queue, created once the loggers exist
+    std::optional<DecodePool> decode_pool;
+    std::list<InFlight> in_flight;
+    // prefetches only fill the caches, they never wait for or hold back other commands
+    std::list<InFlight> prefetching;
     CanvasPtr canvas;
+    // only runs when this daemon writes the disk cache
+    std::optional<CacheEvictor> cache_evictor;
     Logger logger;
 
     jthread command_thread;
 
     void print_header();
-    void setup_signal_handler();
+    auto setup_signal_handler() -> Result<void>;
     auto daemonize() -> Result<void>;
     auto setup_vips() -> Result<void>;
     auto setup_logging() -> Result<void>;
     auto handle_cli_commands() -> Result<void>;
     auto handle_cmd_subcommand() -> Result<void>;
+    auto handle_cache_subcommand() -> Result<void>;
+    void setup_caches();
     auto wait_for_layer_commands() -> Result<void>;
+    [[nodiscard]] auto queue_options() const -> QueueOptions;
     [[nodiscard]] auto set_silent() const -> Result<void>;
     void execute_layer_commands(SToken token);
+    void schedule_queued_commands();
+    auto submit_commands() -> bool;
+    void submit_command(Command &&cmd);
+    auto apply_decoded_commands() -> bool;
+    auto finish_prefetches() -> bool;
+    void apply_command(InFlight &entry);
+    void report_outcomes(const Command &cmd, Clock::time_point started, std::vector<Outcome> &outcomes);
 };
 
 } // namespace upp
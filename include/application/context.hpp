@@ -19,9 +19,14 @@
 #pragma once
 
 #include "buildconfig.hpp"
+#include "image/cancellation.hpp"
+#include "image/pixel_cache.hpp"
+#include "image/pixels.hpp"
+#include "image/disk_cache.hpp"
 #include "log.hpp"
 #include "os/os.hpp"
 #include "terminal.hpp"
+#include "unix/event_loop.hpp"
 #include "util/result.hpp"
 
 #ifdef ENABLE_X11
@@ -60,6 +65,17 @@ class ApplicationContext
     std::string term{os::getenv("TERM").value_or("xterm-256color")};
     std::string term_program{os::getenv("TERM_PROGRAM").value_or("")};
     std::string output;
+    // negotiated by the canvas, decodes write their pixels in this format
+    PixelFormat pixel_format = PixelFormat::rgba;
+    // set by canvases that map pixel fds in the display server, decodes then render into shared memory
+    bool share_pixels = false;
+    CacheFormat cache_format = CacheFormat::image;
+    CachePolicy cache_policy = CachePolicy::read_write;
+    // lists the disk cache entries of every daemon sharing the cache directory
+    CacheIndex cache_index;
+    DecodeCancellation decodes;
+    PixelCache pixel_cache;
+    unix::EventLoop loop;
 #ifdef ENABLE_X11
     X11Context x11;
 #endif
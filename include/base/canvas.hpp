@@ -20,9 +20,13 @@
 
 #include "application/context.hpp"
 #include "command/command.hpp"
+#include "command/response.hpp"
+#include "image/decode_pool.hpp"
 #include "util/result.hpp"
 
 #include <memory>
+#include <span>
+#include <vector>
 
 namespace upp
 {
@@ -38,7 +42,9 @@ class Canvas
 
     static auto create(ApplicationContext *ctx) -> Result<CanvasPtr>;
     virtual auto init() -> Result<void> = 0;
-    virtual void execute(const Command &cmd) = 0;
+    // decoded holds one entry per command, or per child for batches, only add commands use theirs.
+    // Returns one outcome per command, or per child for batches
+    virtual auto execute(const Command &cmd, std::span<Decoded> decoded) -> std::vector<Outcome> = 0;
 };
 
 } // namespace upp
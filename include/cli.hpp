@@ -18,8 +18,11 @@
 
 #pragma once
 
+#include "client/client.hpp"
+
 #include <CLI/CLI.hpp>
 
+#include <cstddef>
 #include <string>
 
 namespace upp::subcommands
@@ -35,6 +38,21 @@ struct layer {
     std::string pid_file;
     std::string parser = "json";
     std::string output;
+
+    std::size_t queue_capacity = 1024;
+    std::string queue_policy = "drop-oldest";
+    int queue_deadline = 0;
+    std::size_t memory_cache_size = 256;
+    std::string cache_format = "image";
+    std::string cache_policy = "read-write";
+    std::size_t disk_cache_size = 1024;
+    std::size_t disk_cache_entries = 0;
+};
+
+struct cache {
+    std::string action;
+    std::size_t disk_cache_size = 1024;
+    std::size_t disk_cache_entries = 0;
 };
 
 struct cmd {
@@ -43,12 +61,17 @@ struct cmd {
     std::string action;
     std::string file_path;
     std::string scaler = "contain";
-    int x;
-    int y;
-    int width;
-    int height;
+    std::string parser = "json";
+    std::string request_id;
+    bool stream = false;
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    int deadline_ms = 0;
 
-    [[nodiscard]] auto get_json_string() const -> std::string;
+    [[nodiscard]] auto get_request() const -> client::Request;
+    [[nodiscard]] auto get_encoding() const -> client::Encoding;
 };
 
 } // namespace upp::subcommands
@@ -65,13 +88,16 @@ class Cli
     CLI::App *layer_command{program.add_subcommand("layer", "Display images on the terminal")};
     CLI::App *cmd_command{program.add_subcommand("cmd", "Send a command to a running ueberzugpp instance")};
     CLI::App *tmux_command{program.add_subcommand("tmux", "Handle tmux hooks. Used internaly")};
+    CLI::App *cache_command{program.add_subcommand("cache", "Show or trim the disk cache")};
 
     subcommands::layer layer;
     subcommands::cmd cmd;
+    subcommands::cache cache;
 
   private:
     void setup_layer_subcommand();
     void setup_cmd_subcommand();
+    void setup_cache_subcommand();
 };
 
 } // namespace upp
@@ -0,0 +1,75 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "command/action.hpp"
+#include "unix/socket/client.hpp"
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Small client library to talk to a running ueberzugpp instance without
+// spawning `ueberzugpp cmd` for every command. Link against ueberzugpp-client.
+namespace upp::client
+{
+
+// must match the parser of the running instance
+enum class Encoding : std::uint8_t { json, binary };
+
+struct Request {
+    Action action = Action::none;
+    std::string_view identifier;
+    std::string_view file_path;
+    std::string_view scaler = "contain";
+    // when set, the instance answers with a json line carrying this id
+    std::string_view request_id;
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    // overrides the queue deadline of the instance when positive
+    int deadline_ms = 0;
+};
+
+// returns a complete message, including its line ending or length prefix
+auto encode(const Request &request, Encoding encoding = Encoding::json) -> Result<std::string>;
+
+class Connection
+{
+  public:
+    explicit Connection(Encoding encoding = Encoding::json);
+
+    auto connect(std::string_view endpoint) -> Result<void>;
+    [[nodiscard]] auto send(const Request &request) const -> Result<void>;
+    // payload must already be framed for the instance's parser
+    [[nodiscard]] auto send_raw(std::string_view payload) const -> Result<void>;
+    // copies everything read from filde to the instance until end of file
+    [[nodiscard]] auto forward(int filde) const -> Result<void>;
+    // blocks until the next response line arrives, see Request::request_id
+    auto receive() -> Result<std::string>;
+
+  private:
+    Encoding encoding;
+    unix::socket::Client socket;
+    std::string received;
+};
+
+} // namespace upp::client
@@ -0,0 +1,75 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace upp
+{
+
+// values are part of the binary protocol, only append new actions
+enum class Action : std::uint8_t {
+    none = 0,
+    add,
+    remove,
+    exit,
+    flush,
+    // carries its commands in Command::batch
+    batch,
+    // commands between begin and commit are executed as one batch
+    begin,
+    commit,
+    // decodes an image into the caches without displaying it
+    prefetch,
+};
+
+namespace detail
+{
+
+using action_pair = std::pair<Action, std::string_view>;
+constexpr auto action_names = std::to_array<action_pair>({
+    {Action::add, "add"},
+    {Action::remove, "remove"},
+    {Action::exit, "exit"},
+    {Action::flush, "flush"},
+    {Action::batch, "batch"},
+    {Action::begin, "begin"},
+    {Action::commit, "commit"},
+    {Action::prefetch, "prefetch"},
+});
+
+} // namespace detail
+
+constexpr auto action_from_string(std::string_view name) -> Action
+{
+    const auto *found = std::ranges::find(detail::action_names, name, &detail::action_pair::second);
+    return found == detail::action_names.end() ? Action::none : found->first;
+}
+
+constexpr auto action_to_string(Action action) -> std::string_view
+{
+    const auto *found = std::ranges::find(detail::action_names, action, &detail::action_pair::first);
+    return found == detail::action_names.end() ? "none" : found->second;
+}
+
+} // namespace upp
@@ -0,0 +1,68 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "command/action.hpp"
+#include "util/result.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace upp::binary
+{
+
+// frame layout, all values are little endian
+//   u32 length of the rest of the frame
+//   u8  protocol version
+//   u8  action, see upp::Action
+//   u16 identifier length
+//   u16 scaler length
+//   u16 request id length, zero when no response is wanted
+//   u32 path length
+//   i32 x, y, width, height
+//   f32 scaling_position_x, scaling_position_y
+//   i32 deadline_ms, overrides the queue deadline when positive
+//   identifier, scaler, path and request id bytes
+// batches can't be framed, use begin and commit frames instead
+constexpr std::uint8_t protocol_version = 2;
+constexpr std::size_t header_size = 40;
+
+struct Frame {
+    Action action = Action::none;
+    std::string_view identifier;
+    std::string_view scaler;
+    std::string_view path;
+    std::string_view request_id;
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    float scaling_position_x = 0;
+    float scaling_position_y = 0;
+    int deadline_ms = 0;
+};
+
+// returns the frame including its length prefix
+auto encode(const Frame &frame) -> Result<std::string>;
+// views in the result point into payload, which must not include the length prefix
+auto decode(std::string_view payload) -> Result<Frame>;
+
+} // namespace upp::binary
@@ -19,34 +19,74 @@
 
 #pragma once
 
-#include "util/concurrent_deque.hpp"
+#include "command/action.hpp"
+#include "command/identifier.hpp"
+#include "util/mpsc_queue.hpp"
 #include "util/result.hpp"
 
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace upp
 {
 
+using Clock = std::chrono::steady_clock;
+
+// commands from stdin, which has no response channel
+constexpr std::uint64_t stdin_source = 0;
+
 struct Command {
-    static auto create(std::string_view parser, std::string line) -> Result<Command>;
-    static auto from_json(std::string line) -> Result<Command>;
+    // json lines must be null terminated, binary frames must not include their length prefix
+    static auto create(std::string_view parser, std::string_view line) -> Result<Command>;
+    static auto from_json(std::string_view line) -> Result<Command>;
+    // single pass parser for the command schema, returns nothing for shapes it doesn't understand
+    static auto from_json_fast(std::string_view line) -> std::optional<Command>;
+    static auto from_json_generic(std::string_view line) -> Result<Command>;
+    // a json array of commands is parsed into a single batch command
+    static auto from_json_array(std::string_view line) -> Result<Command>;
+    // parses many newline delimited json commands in one call, each line as from_json would
+    static auto from_json_lines(std::string_view buffer) -> std::vector<Result<Command>>;
+    static auto from_binary(std::string_view frame) -> Result<Command>;
+    static auto from_simple(std::string_view line) -> Result<Command>;
+    static auto from_bash(std::string_view line) -> Result<Command>;
+
+    // true when the command, or a child of a batch, carries a request id
+    [[nodiscard]] auto wants_response() const -> bool;
 
-    std::string action;
-    std::string preview_id;
+    Action action = Action::none;
+    PreviewId preview_id = no_preview;
     std::string image_scaler = "contain";
-    std::filesystem::path image_path;
+    std::filesystem::path image_path{};
+
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    float scaling_position_x = 0;
+    float scaling_position_y = 0;
 
-    int x;
-    int y;
-    int width;
-    int height;
+    // commands of a batch, applied together by the canvas
+    std::vector<Command> batch{};
 
-    float scaling_position_x;
-    float scaling_position_y;
+    // set by clients that want a response, empty otherwise
+    std::string request_id{};
+    // overrides the default queue deadline when positive
+    int deadline_ms = 0;
+    // connection the command arrived on and when, filled in by the listener
+    std::uint64_t source = stdin_source;
+    Clock::time_point received{};
+    // Identifiers::serial() once the command was parsed, a remove releases its handle with it
+    std::uint64_t identifier_serial = 0;
+    // commands still queued after this are dropped instead of executed
+    Clock::time_point deadline = Clock::time_point::max();
 };
 
-using CommandQueue = ConcurrentDeque<Command>;
+using CommandQueue = MpscQueue<Command>;
 
 } // namespace upp
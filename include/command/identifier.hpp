@@ -0,0 +1,49 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace upp
+{
+
+// interned preview identifier, compared and hashed as an integer
+using PreviewId = std::uint32_t;
+
+constexpr PreviewId no_preview = 0;
+
+// Handles live until their preview is removed, a name interned again after
+// that gets a new handle. Handles are never reused.
+class Identifiers
+{
+  public:
+    // returns the same handle for the same name, the empty name maps to no_preview
+    static auto intern(std::string_view name) -> PreviewId;
+    static auto name(PreviewId preview_id) -> std::string;
+
+    // counts every intern, read on the interning thread right after parsing a command
+    static auto serial() -> std::uint64_t;
+    // forgets the handle unless its name was interned after serial, a command
+    // parsed later may still carry it
+    static void release(PreviewId preview_id, std::uint64_t serial);
+};
+
+} // namespace upp
@@ -18,36 +18,92 @@
 
 #pragma once
 
+#include "application/context.hpp"
 #include "command/command.hpp"
+#include "command/response.hpp"
 #include "log.hpp"
 #include "unix/socket.hpp"
-#include "util/thread.hpp"
+#include "util/ring_buffer.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 
 namespace upp
 {
 
+// what happens to a command that arrives while the command queue is full
+enum class OverflowPolicy : std::uint8_t { drop_oldest, drop_newest, block };
+
+struct QueueOptions {
+    OverflowPolicy policy = OverflowPolicy::drop_oldest;
+    // commands not executed within this time are dropped, zero disables it
+    std::chrono::milliseconds deadline{0};
+};
+
+struct ListenerStats {
+    std::uint64_t dropped_oldest = 0;
+    std::uint64_t dropped_newest = 0;
+    std::uint64_t blocked = 0;
+    // blocked commands dropped at their deadline
+    std::uint64_t block_timeouts = 0;
+};
+
 class CommandListener
 {
   public:
     explicit CommandListener(CommandQueue *queue);
-    auto start(std::string_view new_parser, bool no_stdin) -> Result<void>;
+    auto start(std::string_view new_parser, bool no_stdin, QueueOptions options) -> Result<void>;
+    // any thread, the response is written from the event loop
+    void respond(Response &&response);
+    // answers every request in cmd, including the children of batches
+    void respond_dropped(const Command &cmd, Status status);
+    [[nodiscard]] auto stats() const -> ListenerStats;
+
+    static auto policy_from_string(std::string_view policy) -> OverflowPolicy;
+    // cells of the command queue that only flush markers may fill, so a full queue can still be flushed
+    static constexpr std::size_t reserved_cells = 1;
 
   private:
-    void wait_for_input_on_stdin(SToken token);
-    void wait_for_input_on_socket(SToken token);
-    void extract_commands(std::string_view line);
-    void flush_command_queue() const;
-    void enqueue_or_discard(const Command &cmd);
+    auto listen_on_stdin() -> Result<void>;
+    auto read_from_stdin() -> bool;
+    void read_from_socket();
+    void send_responses();
+    void parse_command(std::uint64_t source, std::string_view line);
+    // control commands are applied by the listener, their response only confirms it
+    void acknowledge(const Command &cmd, Result<void> result = {});
+    void flush_command_queue();
+    void enqueue(Command &&cmd);
+    void set_deadline(Command &cmd) const;
+    void evict_oldest();
+    auto wait_for_space(Command &cmd) -> bool;
+    void cancel_superseded_decodes(const Command &cmd);
+    void enqueue_batch(Command &&batch);
+    void add_command(std::uint64_t source, Command &&cmd);
+    void begin_batch(std::uint64_t source);
+    auto commit_batch(std::uint64_t source) -> Result<void>;
+    void discard_batch(std::uint64_t source);
 
     CommandQueue *queue;
+    QueueOptions options;
+    std::shared_ptr<ApplicationContext> ctx{ApplicationContext::get()};
     std::string parser;
-    jthread stdin_thread;
-    jthread socket_thread;
     unix::socket::Server socket_server;
+    RingBuffer stdin_buffer;
+    MpscQueue<Response> responses;
+    // open begin/commit batches by source
+    std::unordered_map<std::uint64_t, Command> pending_batches;
     Logger logger;
+
+    std::atomic_uint64_t dropped_oldest{0};
+    std::atomic_uint64_t dropped_newest{0};
+    std::atomic_uint64_t blocked{0};
+    std::atomic_uint64_t block_timeouts{0};
 };
 
 } // namespace upp
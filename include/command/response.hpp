@@ -0,0 +1,77 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "command/command.hpp"
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace upp
+{
+
+enum class Status : std::uint8_t { ok, failed, superseded, discarded, dropped, expired };
+
+struct Timings {
+    Clock::duration queue_wait{};
+    Clock::duration decode{};
+    Clock::duration upload{};
+    Clock::duration present{};
+};
+
+// what happened to a single command on the canvas, batches report one per child
+struct Outcome {
+    Result<void> result{};
+    Timings timings{};
+};
+
+// sent back on the connection of commands that carry a request id
+struct Response {
+    std::uint64_t source = stdin_source;
+    std::string request_id{};
+    Status status = Status::ok;
+    std::string error{};
+    Timings timings{};
+
+    static auto from_outcome(const Command &cmd, const Outcome &outcome) -> Response;
+    static auto dropped(const Command &cmd, Status status) -> Response;
+    // a single json line, including the newline
+    [[nodiscard]] auto to_json() const -> std::string;
+};
+
+// runs func and adds the time it took to elapsed
+template <class Func>
+auto measure(Clock::duration &elapsed, Func &&func)
+{
+    const auto start = Clock::now();
+    if constexpr (std::is_void_v<std::invoke_result_t<Func>>) {
+        std::forward<Func>(func)();
+        elapsed += Clock::now() - start;
+    } else {
+        auto result = std::forward<Func>(func)();
+        elapsed += Clock::now() - start;
+        return result;
+    }
+}
+
+} // namespace upp
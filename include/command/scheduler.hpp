@@ -0,0 +1,85 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "command/command.hpp"
+#include "command/identifier.hpp"
+#include "command/response.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <unordered_map>
+
+namespace upp
+{
+
+struct SchedulerStats {
+    std::uint64_t scheduled = 0;
+    std::uint64_t coalesced = 0;
+    std::uint64_t executed = 0;
+    std::uint64_t expired = 0;
+};
+
+// Keeps at most one pending command per preview identifier. A newer command
+// replaces the pending one in place, so commands for different identifiers
+// keep their FIFO order. Batches act as barriers and are never coalesced.
+// Commands past their deadline are dropped instead of returned by next().
+// Prefetches wait in their own bounded list and are only handed out by
+// next_prefetch() while no other command is pending.
+// Only used from the command thread, stats() can be read from anywhere.
+class CommandScheduler
+{
+  public:
+    // receives commands that will never execute
+    using DropCallback = std::function<void(const Command &, Status)>;
+
+    explicit CommandScheduler(DropCallback on_drop);
+
+    void schedule(Command &&cmd);
+    auto next() -> std::optional<Command>;
+    auto next_prefetch() -> std::optional<Command>;
+    void clear();
+
+    [[nodiscard]] auto empty() const -> bool;
+    [[nodiscard]] auto stats() const -> SchedulerStats;
+
+    // older prefetches are superseded once this many are waiting
+    static constexpr std::size_t max_prefetches = 64;
+
+  private:
+    using CommandList = std::list<Command>;
+
+    DropCallback on_drop;
+    CommandList pending;
+    CommandList prefetches;
+    std::unordered_map<PreviewId, CommandList::iterator> latest;
+
+    std::atomic_uint64_t scheduled{0};
+    std::atomic_uint64_t coalesced{0};
+    std::atomic_uint64_t executed{0};
+    std::atomic_uint64_t expired{0};
+
+    auto take_next(CommandList &list) -> std::optional<Command>;
+};
+
+} // namespace upp
@@ -0,0 +1,115 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "util/result.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace upp
+{
+
+enum class CacheFormat : std::uint8_t {
+    // the resized image, encoded like its source
+    image,
+    // display ready pixels, mapped on a hit
+    raw,
+    // display ready pixels compressed with QOI, a fraction of the size of raw and quick to decode
+    qoi,
+};
+
+struct CacheIndexEntry {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    CacheFormat format = CacheFormat::image;
+    // bytes of the cache file
+    std::uint64_t size = 0;
+    // seconds since the epoch
+    std::int64_t last_access = 0;
+};
+
+struct CacheIndexRecord {
+    std::uint64_t digest = 0;
+    CacheIndexEntry entry{};
+};
+
+// counted over every daemon sharing the index since it was created or cleared
+struct CacheIndexStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+};
+
+// Memory mapped hash table of the entries in the disk caches, keyed by
+// PixelKey::digest and format. It is shared by every daemon using the same
+// cache directory: slots are updated under a per slot sequence lock with
+// atomics on the shared mapping, so lookups need no syscalls and no file
+// locks. The index is advisory, an entry it misses is decoded again and one it
+// lists that is gone from disk is erased by whoever notices.
+class CacheIndex
+{
+  public:
+    CacheIndex() = default;
+    ~CacheIndex();
+    CacheIndex(const CacheIndex &) = delete;
+    auto operator=(const CacheIndex &) -> CacheIndex & = delete;
+
+    // creates the file when missing, without an open index lookups must probe the cache files
+    auto open(const std::filesystem::path &path) -> Result<void>;
+    [[nodiscard]] auto is_open() const -> bool;
+
+    // refreshes the last access time of a hit
+    auto find(std::uint64_t digest, CacheFormat format) -> std::optional<CacheIndexEntry>;
+    // stamps the entry as accessed now, may replace the least recently used entry of the probed slots
+    void insert(std::uint64_t digest, CacheIndexEntry entry);
+    void erase(std::uint64_t digest, CacheFormat format);
+    // forgets every entry and resets the counters, the cache files are left alone
+    void clear();
+
+    // a copy of every listed entry, slots updated meanwhile may be missed
+    [[nodiscard]] auto snapshot() const -> std::vector<CacheIndexRecord>;
+    [[nodiscard]] auto stats() const -> CacheIndexStats;
+    void count_evictions(std::uint64_t count);
+
+    // name of the index file in the cache directory
+    static constexpr std::string_view file_name = "index";
+    static constexpr std::size_t slot_count = 1UL << 16U;
+    static constexpr std::size_t max_probes = 8;
+
+  private:
+    struct Slot;
+
+    void *mapping = nullptr;
+    std::size_t mapping_size = 0;
+    Slot *slots = nullptr;
+    struct Counters;
+    Counters *counters = nullptr;
+
+    // calls visit with the probed slots of the key until it returns true
+    void probe(std::uint64_t digest, CacheFormat format, const std::function<bool(Slot &)> &visit);
+};
+
+} // namespace upp
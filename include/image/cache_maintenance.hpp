@@ -0,0 +1,104 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "image/cache_index.hpp"
+#include "log.hpp"
+#include "util/result.hpp"
+#include "util/thread.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+namespace upp
+{
+
+// zero means no limit
+struct CacheBudget {
+    std::uint64_t bytes = 0;
+    std::size_t entries = 0;
+};
+
+struct CacheUsage {
+    std::size_t entries = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Keeps the disk cache directory within a budget, least recently used entries
+// go first. Access times come from the index, files it doesn't list can't be
+// found by a lookup and are removed once they are older than a grace period
+// that covers entries still being written. Without an open index the file
+// modification times are used instead. Used by the daemon in the background
+// and by the cache subcommand.
+class CacheMaintenance
+{
+  public:
+    CacheMaintenance(std::filesystem::path directory, CacheIndex *index);
+
+    [[nodiscard]] auto usage() const -> Result<CacheUsage>;
+    // returns what was removed
+    [[nodiscard]] auto prune(const CacheBudget &budget) const -> Result<CacheUsage>;
+    [[nodiscard]] auto clear() const -> Result<CacheUsage>;
+
+    static constexpr std::chrono::seconds orphan_grace{std::chrono::minutes{10}};
+
+  private:
+    struct CacheFile {
+        std::filesystem::path path{};
+        std::uint64_t size = 0;
+        std::int64_t last_access = 0;
+        std::uint64_t digest = 0;
+        CacheFormat format = CacheFormat::image;
+        bool listed = false;
+    };
+
+    std::filesystem::path directory;
+    CacheIndex *index;
+
+    [[nodiscard]] auto list_files() const -> Result<std::vector<CacheFile>>;
+    auto remove(const std::vector<CacheFile> &files) const -> CacheUsage;
+};
+
+// prunes the disk cache on its own thread, right away and then every interval
+class CacheEvictor
+{
+  public:
+    CacheEvictor(CacheMaintenance maintenance, CacheBudget budget);
+
+    static constexpr std::chrono::minutes interval{5};
+
+  private:
+    CacheMaintenance maintenance;
+    CacheBudget budget;
+    Logger logger{spdlog::get("application")};
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    // last, so it is joined before the members it uses are destroyed
+    jthread thread;
+
+    void run(SToken token);
+};
+
+} // namespace upp
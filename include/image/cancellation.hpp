@@ -0,0 +1,48 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "command/identifier.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace upp
+{
+
+// Decodes register themselves per preview identifier, the command listener
+// cancels them as soon as a newer command for the same preview arrives.
+class DecodeCancellation
+{
+  public:
+    using Flag = std::shared_ptr<std::atomic_bool>;
+
+    auto track(PreviewId preview_id) -> Flag;
+    void untrack(PreviewId preview_id, const Flag &flag);
+    auto cancel(PreviewId preview_id) -> bool;
+    void cancel_all();
+
+  private:
+    std::mutex mutex;
+    std::unordered_map<PreviewId, Flag> in_flight;
+};
+
+} // namespace upp
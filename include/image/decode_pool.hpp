@@ -0,0 +1,84 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "application/context.hpp"
+#include "command/command.hpp"
+#include "image/pixel_cache.hpp"
+#include "image/disk_cache.hpp"
+#include "image/vips.hpp"
+#include "log.hpp"
+#include "util/result.hpp"
+
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace upp
+{
+
+// an image ready to be handed to a window, or why it could not be decoded
+struct Decoded {
+    Result<PixelBufferPtr> image{};
+    Clock::duration elapsed{};
+};
+
+// Runs LibvipsImage::load on TBB workers so previews with different
+// identifiers decode in parallel. Images found in the pixel cache, or in the
+// pixel disk cache when enabled, are not decoded again, decoded ones are added
+// to both. Windows are only touched by the thread
+// that applies the results, never by the workers. Prefetches run in a low
+// priority arena, workers prefer decodes for images that are shown.
+class DecodePool
+{
+  public:
+    // on_decoded runs on the worker right after a result becomes ready
+    DecodePool(ApplicationContext *ctx, std::function<void()> on_decoded);
+    ~DecodePool();
+
+    DecodePool(const DecodePool &) = delete;
+    auto operator=(const DecodePool &) -> DecodePool & = delete;
+
+    // reads the terminal font, call with the state mutex held
+    auto submit(const Command &cmd) -> std::future<Decoded>;
+    // blocks until every submitted decode finished
+    void wait();
+
+    [[nodiscard]] auto concurrency() -> int;
+
+  private:
+    ApplicationContext *ctx;
+    std::function<void()> on_decoded;
+    Logger logger{spdlog::get("vips")};
+    DiskCache disk_cache;
+
+    tbb::task_arena arena;
+    tbb::task_arena background;
+    tbb::task_group group;
+    tbb::task_group background_group;
+
+    auto decode(ImageProps props, PixelCache::Priority priority) -> Result<PixelBufferPtr>;
+    auto load_from_disk(const PixelKey &key) -> Result<PixelBufferPtr>;
+    void store_on_disk(const PixelKey &key, const PixelBuffer &buffer);
+};
+
+} // namespace upp
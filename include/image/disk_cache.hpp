@@ -0,0 +1,80 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "image/cache_index.hpp"
+#include "image/pixel_cache.hpp"
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace upp
+{
+
+enum class CachePolicy : std::uint8_t {
+    // nothing is cached, not even in memory
+    off,
+    // cache entries are used but never written, e.g. for a cache directory prepared by someone else
+    read_only,
+    // only the pixel cache of the running daemon
+    memory_only,
+    read_write,
+};
+
+constexpr auto reads_disk(CachePolicy policy) -> bool
+{
+    return policy == CachePolicy::read_only || policy == CachePolicy::read_write;
+}
+
+constexpr auto writes_disk(CachePolicy policy) -> bool
+{
+    return policy == CachePolicy::read_write;
+}
+
+// Disk cache of pixels already converted to the output layout. An entry is a
+// small header identifying the source and the decode, followed by the pixels
+// as raw bytes or QOI. A raw hit is an mmap with no decoding at all, a QOI hit
+// decodes straight into the buffer handed to the canvas. Entries are replaced
+// by rename, mappings held by windows stay valid. When the index is open a
+// miss is answered by it without touching the directory.
+class DiskCache
+{
+  public:
+    DiskCache(std::filesystem::path directory, CacheIndex *index);
+
+    static auto format_from_string(std::string_view format) -> CacheFormat;
+    static auto policy_from_string(std::string_view policy) -> CachePolicy;
+
+    // share is passed on to allocate_pixels for decoded entries
+    [[nodiscard]] auto load(const PixelKey &key, CacheFormat format, bool share) const -> Result<PixelBufferPtr>;
+    [[nodiscard]] auto store(const PixelKey &key, const PixelBuffer &buffer, CacheFormat format) const
+        -> Result<void>;
+
+  private:
+    std::filesystem::path directory;
+    CacheIndex *index;
+
+    [[nodiscard]] auto load_entry(const PixelKey &key, CacheFormat format, bool share) const
+        -> Result<PixelBufferPtr>;
+    [[nodiscard]] auto entry_path(const PixelKey &key, CacheFormat format) const -> std::filesystem::path;
+};
+
+} // namespace upp
@@ -0,0 +1,140 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "image/pixels.hpp"
+#include "util/result.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace upp
+{
+
+// Display ready pixels, never modified once created. Windows and the cache
+// share them, owner keeps the memory behind pixels alive.
+struct PixelBuffer {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::span<const unsigned char> pixels{};
+    std::shared_ptr<const void> owner{};
+    // memfd holding the pixels at offset 0, -1 when they live in private memory
+    int fd = -1;
+};
+
+using PixelBufferPtr = std::shared_ptr<const PixelBuffer>;
+
+// writable memory for the pixels of a new PixelBuffer
+struct PixelStorage {
+    std::span<unsigned char> pixels{};
+    std::shared_ptr<const void> owner{};
+    int fd = -1;
+};
+
+// uses a sealed memfd when share is set, private memory if that fails or share isn't set
+auto allocate_pixels(std::size_t size, bool share) -> PixelStorage;
+
+// identifies the file by what changes when it is replaced or edited
+struct PixelKey {
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::int64_t mtime_ns = 0;
+    std::uint64_t file_size = 0;
+    int width = 0;
+    int height = 0;
+    std::string scaler{};
+    PixelFormat format = PixelFormat::bgra;
+
+    // width and height are the box the image is scaled into, in pixels
+    static auto create(const std::string &path, int width, int height, std::string_view scaler, PixelFormat format)
+        -> Result<PixelKey>;
+    // hash of every field, stable across runs so disk caches are named by it
+    [[nodiscard]] auto digest() const -> std::uint64_t;
+    auto operator==(const PixelKey &other) const -> bool = default;
+};
+
+struct PixelKeyHash {
+    auto operator()(const PixelKey &key) const noexcept -> std::size_t;
+};
+
+struct PixelCacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+};
+
+// Process wide LRU of decoded images, bounded by the bytes of its buffers and
+// by the number of memfds they keep open. Buffers still shown by a window stay
+// alive after eviction. Thread safe.
+class PixelCache
+{
+  public:
+    enum class Priority : std::uint8_t {
+        normal,
+        // inserted as the next entry to evict, e.g. for prefetches
+        low,
+    };
+
+    static constexpr std::size_t default_budget = 256UL * 1024 * 1024;
+    // small images would otherwise exhaust the usual limit of 1024 open files
+    static constexpr std::size_t max_shared_buffers = 256;
+
+    // zero disables the cache
+    void set_budget(std::size_t bytes);
+    auto find(const PixelKey &key) -> PixelBufferPtr;
+    void insert(const PixelKey &key, PixelBufferPtr buffer, Priority priority = Priority::normal);
+    void clear();
+
+    [[nodiscard]] auto stats() const -> PixelCacheStats;
+
+  private:
+    struct Entry {
+        PixelKey key;
+        PixelBufferPtr buffer;
+    };
+    using EntryList = std::list<Entry>;
+
+    mutable std::mutex mutex;
+    // most recently used first
+    EntryList entries;
+    std::unordered_map<PixelKey, EntryList::iterator, PixelKeyHash> index;
+    std::size_t budget = default_budget;
+    std::size_t bytes = 0;
+    // entries whose buffer holds a memfd
+    std::size_t shared = 0;
+
+    std::atomic_uint64_t hits{0};
+    std::atomic_uint64_t misses{0};
+    std::atomic_uint64_t evictions{0};
+
+    void evict_until(std::size_t limit, std::size_t shared_limit);
+};
+
+} // namespace upp
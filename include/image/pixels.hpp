@@ -0,0 +1,58 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace upp
+{
+
+// byte order of the pixels an output expects
+enum class PixelFormat : std::uint8_t {
+    // X11 TrueColor visuals, the alpha byte is ignored by the server
+    bgra,
+    // wl_shm ARGB8888, colors are premultiplied by alpha
+    bgra_premultiplied,
+    // sixel, transparent pixels are flattened against black
+    rgb,
+    rgba,
+};
+
+// the format used until the canvas negotiates one with the display server
+auto output_pixel_format(std::string_view output) -> PixelFormat;
+
+} // namespace upp
+
+namespace upp::image
+{
+
+constexpr auto bytes_per_pixel(PixelFormat format) -> int
+{
+    return format == PixelFormat::rgb ? 3 : 4;
+}
+
+// Converts a row of 8 bit grey, grey + alpha, rgb or rgba pixels, as given by
+// bands, into format. dst must hold width * bytes_per_pixel(format) bytes.
+// Uses AVX2 or SSE4.1 when the cpu supports them.
+void convert_row(std::span<const std::uint8_t> src, int bands, std::span<std::uint8_t> dst, PixelFormat format);
+
+} // namespace upp::image
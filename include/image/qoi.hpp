@@ -0,0 +1,46 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// QOI, "the Quite OK Image Format", see https://qoiformat.org/qoi-specification.pdf
+// Lossless and several times faster to decode than PNG. The channels are
+// stored in whatever order they are given, so display ready pixels go
+// through unchanged.
+namespace upp::qoi
+{
+
+struct Header {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+};
+
+// channels is 3 or 4
+auto encode(std::span<const std::uint8_t> pixels, int width, int height, int channels) -> std::vector<std::uint8_t>;
+auto read_header(std::span<const std::uint8_t> data) -> Result<Header>;
+// pixels must hold width * height * channels bytes of the header
+auto decode(std::span<const std::uint8_t> data, std::span<std::uint8_t> pixels) -> Result<void>;
+
+} // namespace upp::qoi
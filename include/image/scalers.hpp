@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <string_view>
+
 namespace upp::image
 {
 
@@ -35,5 +37,7 @@ struct target_sizes {
 
 auto fit_contain_sizes(current_sizes sizes) -> target_sizes;
 auto contain_sizes(current_sizes sizes) -> target_sizes;
+// size the image is decoded at for scaler, unknown scalers keep the image size
+auto scaled_sizes(std::string_view scaler, current_sizes sizes) -> target_sizes;
 
 } // namespace upp::image
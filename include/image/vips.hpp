@@ -19,12 +19,18 @@
 #pragma once
 
 #include "application/context.hpp"
+#include "command/identifier.hpp"
+#include "image/cancellation.hpp"
+#include "image/pixel_cache.hpp"
+#include "image/pixels.hpp"
 #include "log.hpp"
 #include "util/ptr.hpp"
 #include "util/result.hpp"
 
 #include <vips/vips.h>
 
+#include <cstddef>
+#include <memory>
 #include <optional>
 #include <span>
 #include <string>
@@ -40,6 +46,11 @@ struct ImageProps {
     std::string scaler;
     int width = -1;
     int height = -1;
+    PreviewId preview_id = no_preview;
+    // set from the moment the decode is submitted, shown previews only
+    DecodeCancellation::Flag cancelled{};
+    // names the disk cache entry, nothing is cached without it
+    std::optional<PixelKey> key{};
 };
 
 class LibvipsImage
@@ -53,20 +64,31 @@ class LibvipsImage
     auto data_size() -> int;
     auto width() -> int;
     auto height() -> int;
+    // hands the decoded pixels over, the image can't be used afterwards
+    auto release_buffer() -> PixelBufferPtr;
 
   private:
     Logger logger{spdlog::get("vips")};
     ApplicationContext *ctx;
     ImageProps props;
-    VipsImage *image;
-    VipsImage *image_out;
-    glib_ptr<unsigned char> image_buffer;
+    VipsSource *source = nullptr;
+    VipsImage *image = nullptr;
+    VipsImage *image_out = nullptr;
+    PixelStorage storage;
+    PixelFormat format = PixelFormat::rgba;
 
     auto read_image() -> Result<void>;
-    void resize_image();
-    void process_image();
-    void contain_scaler();
-    auto image_is_cached(int new_width, int new_height) -> bool;
+    auto resize_image() -> Result<void>;
+    auto process_image() -> Result<void>;
+    // converts the final stage into format, row by row as vips renders it
+    auto render_into(std::span<unsigned char> destination) -> Result<void>;
+    // decodes the source straight at the target size
+    auto shrink_on_load(int new_width, int new_height) -> Result<void>;
+    void watch_for_cancellation(VipsImage *target);
+    void save_to_cache();
+    [[nodiscard]] auto is_cancelled() const -> bool;
+    auto image_is_cached() -> bool;
+    [[nodiscard]] auto cache_file_path() const -> std::string;
     [[nodiscard]] auto origin_is_animated() const -> bool;
     auto get_frame_delays() -> std::optional<std::span<int>>;
 };
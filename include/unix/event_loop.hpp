@@ -0,0 +1,67 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "unix/fd.hpp"
+#include "util/result.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <unordered_map>
+
+namespace upp::unix
+{
+
+// receives the epoll events that fired for the fd
+using EventCallback = std::function<void(std::uint32_t)>;
+// receives the number of the signal that was delivered
+using SignalCallback = std::function<void(int)>;
+
+// Single epoll reactor, every fd the application waits on is registered here
+// and its callback runs on the thread that calls run(). Only stop() may be
+// called from other threads.
+class EventLoop
+{
+  public:
+    auto init() -> Result<void>;
+    auto add(int filde, EventCallback callback) -> Result<void>;
+    void remove(int filde);
+    // blocks the signals for the whole process, call before spawning threads
+    auto add_signals(std::initializer_list<int> signals, SignalCallback callback) -> Result<void>;
+    auto run() -> Result<void>;
+    void stop();
+    [[nodiscard]] auto is_stopped() const -> bool;
+
+    static constexpr int max_events = 64;
+
+  private:
+    fd epollfd;
+    fd wakefd;
+    fd signalfd;
+    // shared so a callback can remove its own fd while it runs
+    std::unordered_map<int, std::shared_ptr<EventCallback>> callbacks;
+    std::atomic_bool stopped{false};
+
+    void drain_wakeups() const;
+};
+
+} // namespace upp::unix
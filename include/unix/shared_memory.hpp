@@ -0,0 +1,54 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "unix/fd.hpp"
+#include "util/result.hpp"
+
+#include <cstddef>
+#include <span>
+
+namespace upp::unix
+{
+
+// Anonymous memfd mapped read/write. The size is sealed, so the fd can be
+// handed to a display server that maps it without risking SIGBUS.
+class SharedMemory
+{
+  public:
+    static auto create(std::size_t size) -> Result<SharedMemory>;
+
+    ~SharedMemory();
+    SharedMemory(const SharedMemory &) = delete;
+    auto operator=(const SharedMemory &) -> SharedMemory & = delete;
+    SharedMemory(SharedMemory &&other) noexcept;
+    auto operator=(SharedMemory &&other) noexcept -> SharedMemory &;
+
+    [[nodiscard]] auto data() const -> std::span<unsigned char>;
+    [[nodiscard]] auto get_fd() const -> int;
+
+  private:
+    SharedMemory() = default;
+
+    fd memfd;
+    unsigned char *address = nullptr;
+    std::size_t size = 0;
+};
+
+} // namespace upp::unix
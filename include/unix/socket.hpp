@@ -18,46 +18,76 @@
 
 #pragma once
 
+#include "log.hpp"
 #include "unix/fd.hpp"
+#include "unix/socket/client.hpp"
 #include "util/result.hpp"
+#include "util/ring_buffer.hpp"
 
 #include <cstddef>
-#include <span>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 
 namespace upp::unix::socket
 {
 
-class Client
-{
-  public:
-    auto connect(std::string_view endpoint) -> Result<void>;
-    auto connect_and_write(std::string_view endpoint, std::span<const std::byte> buffer) -> Result<void>;
-    [[nodiscard]] auto write(std::span<const std::byte> buffer) const -> Result<void>;
-    [[nodiscard]] auto read(std::span<std::byte> buffer) const -> Result<void>;
-    [[nodiscard]] auto read_until_empty() const -> Result<std::string>;
+// unique for the lifetime of the server, unlike fds which get reused
+using ConnectionId = std::uint64_t;
+// receives the connection id and a single message without its framing
+using DataCallback = std::function<void(ConnectionId, std::string_view)>;
+// receives the id of a connection that was closed
+using CloseCallback = std::function<void(ConnectionId)>;
 
-  private:
-    fd sockfd;
+struct Connection {
+    fd connfd;
+    RingBuffer buffer;
+    // whole messages the socket didn't take yet, sent when it becomes writable
+    std::string output{};
+    bool watching_output = false;
 };
 
 class Server
 {
   public:
     ~Server();
-    auto start() -> Result<void>;
+    auto start(Framing new_framing = Framing::newline) -> Result<void>;
+    // pollable fd, becomes readable when there are new connections or data on any of them
     [[nodiscard]] auto get_fd() const -> int;
     [[nodiscard]] auto get_endpoint() const -> std::string;
-    [[nodiscard]] auto read_data_from_connection() const -> Result<std::string>;
+    auto read_data_from_connections(const DataCallback &on_data, const CloseCallback &on_close) -> Result<void>;
+    // never blocks, what the socket doesn't take is kept and sent later so
+    // messages are never cut. A peer that lets more than max_pending_output
+    // bytes pile up is disconnected.
+    auto send(ConnectionId conn_id, std::string_view data) -> Result<void>;
+
+    static constexpr int max_events = 64;
+    static constexpr std::size_t max_pending_output = 1024UL * 1024;
+    // epoll data of the listening socket, connections start after it
+    static constexpr ConnectionId listener_id = 0;
 
   private:
     fd sockfd;
+    fd epollfd;
     std::string endpoint;
+    std::unordered_map<ConnectionId, Connection> connections;
+    ConnectionId last_id = listener_id;
+    Framing framing = Framing::newline;
+    Logger logger;
 
     auto create_socket() -> Result<void>;
+    auto create_epoll() -> Result<void>;
     [[nodiscard]] auto bind_to_endpoint() const -> Result<void>;
     [[nodiscard]] auto listen_for_connections() const -> Result<void>;
+    [[nodiscard]] auto watch_fd(int filde, ConnectionId conn_id) const -> Result<void>;
+    void accept_connections();
+    void read_from_connection(ConnectionId conn_id, const DataCallback &on_data, const CloseCallback &on_close);
+    // returns false when the connection broke
+    auto flush_output(ConnectionId conn_id, Connection &conn) const -> bool;
+    // the read side sees the connection closed and removes it
+    void disconnect(Connection &conn) const;
 };
 
 } // namespace upp::unix::socket
@@ -25,7 +25,6 @@ namespace upp::crypto
 {
 
 auto buffer_to_hexstring(std::span<const std::byte> buffer) -> std::string;
-auto blake2b_encode(std::span<const std::byte> buffer) -> std::string;
 auto base64_encode(std::span<const std::byte> buffer) -> std::string;
 auto generate_random_string(int length) -> std::string;
 
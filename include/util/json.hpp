@@ -0,0 +1,53 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace upp::util
+{
+
+// appends value as a quoted json string
+inline void append_json_string(std::string &out, std::string_view value)
+{
+    out.push_back('"');
+    for (const char chr : value) {
+        switch (chr) {
+            case '"':
+                out.append(R"(\")");
+                break;
+            case '\\':
+                out.append(R"(\\)");
+                break;
+            default:
+                if (static_cast<unsigned char>(chr) < 0x20) {
+                    std::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned char>(chr));
+                } else {
+                    out.push_back(chr);
+                }
+                break;
+        }
+    }
+    out.push_back('"');
+}
+
+} // namespace upp::util
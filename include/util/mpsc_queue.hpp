@@ -0,0 +1,265 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "unix/fd.hpp"
+#include "util/result.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace upp
+{
+
+// Bounded lock-free multi-producer/single-consumer queue based on Dmitry
+// Vyukov's sequenced ring. The consumer sleeps on an eventfd that producers
+// only signal when it is actually waiting, get_fd() can be polled alongside
+// other descriptors. Producers may evict the oldest item to make room, the
+// dequeue side is serialized by a spinlock that is uncontended otherwise.
+// The last reserved cells are only filled by try_enqueue_reserved.
+template <class T>
+class MpscQueue
+{
+  public:
+    static constexpr std::size_t default_capacity = 1024;
+
+    explicit MpscQueue(std::size_t capacity = default_capacity, std::size_t reserved = 0) :
+        cells(std::make_unique<Cell[]>(std::bit_ceil(capacity))),
+        mask(std::bit_ceil(capacity) - 1),
+        reserved(std::min(reserved, mask)),
+        eventfd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    {
+        for (std::size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // any thread, item is left untouched when the queue is full
+    auto try_enqueue(T &&item) -> bool { return enqueue_within(std::move(item), capacity() - reserved); }
+
+    // any thread, like try_enqueue but may also fill the reserved cells
+    auto try_enqueue_reserved(T &&item) -> bool { return enqueue_within(std::move(item), capacity()); }
+
+    // consumer, or producers evicting the oldest item
+    auto try_dequeue() -> std::optional<T>
+    {
+        while (dequeue_lock.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        auto item = dequeue_unlocked();
+        dequeue_lock.clear(std::memory_order_release);
+        return item;
+    }
+
+    // like try_dequeue, but leaves the oldest item in place unless accept returns true for it
+    template <class Predicate>
+    auto try_dequeue_if(Predicate &&accept) -> std::optional<T>
+    {
+        while (dequeue_lock.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        std::optional<T> item;
+        if (const T *head = peek_unlocked(); head != nullptr && accept(*head)) {
+            item = take_head();
+        }
+        dequeue_lock.clear(std::memory_order_release);
+        return item;
+    }
+
+    // any thread, approximate when called concurrently
+    [[nodiscard]] auto empty() const -> bool
+    {
+        const auto pos = dequeue_pos.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // consumer only, returns false on timeout
+    auto wait(int timeout_ms = -1) -> Result<bool>
+    {
+        if (!arm()) {
+            return true;
+        }
+
+        pollfd fds{.fd = eventfd.get(), .events = POLLIN, .revents = 0};
+        const int result = poll(&fds, 1, timeout_ms);
+        consumer_waiting.store(false, std::memory_order_relaxed);
+        if (result == -1) {
+            if (errno == EINTR) {
+                return false;
+            }
+            return Err("could not wait for queue");
+        }
+        acknowledge();
+        return result != 0;
+    }
+
+    // consumer only, for consumers that poll get_fd() themselves: asks producers
+    // to signal the fd, returns false if items arrived that must be dequeued first
+    auto arm() -> bool
+    {
+        consumer_waiting.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!empty()) {
+            consumer_waiting.store(false, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // consumer only, resets the readiness of get_fd()
+    void acknowledge() const
+    {
+        std::uint64_t value = 0;
+        [[maybe_unused]] auto bytes_read = read(eventfd.get(), &value, sizeof(value));
+    }
+
+    // any thread, wakes up the consumer, e.g. to let it notice a stop request
+    void notify() const
+    {
+        constexpr std::uint64_t one = 1;
+        [[maybe_unused]] auto written = write(eventfd.get(), &one, sizeof(one));
+    }
+
+    // any thread, drops everything that was enqueued before this call
+    void clear()
+    {
+        const auto pos = enqueue_pos.load(std::memory_order_acquire);
+        auto current = discard_until.load(std::memory_order_relaxed);
+        while (current < pos && !discard_until.compare_exchange_weak(current, pos, std::memory_order_release)) {
+        }
+    }
+
+    // approximate when called concurrently
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        return enqueue_pos.load(std::memory_order_relaxed) - dequeue_pos.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto capacity() const -> std::size_t { return mask + 1; }
+
+    [[nodiscard]] auto get_fd() const -> int { return eventfd.get(); }
+
+  private:
+    // std::hardware_destructive_interference_size is not ABI stable
+    static constexpr std::size_t cache_line = 64;
+
+    struct Cell {
+        std::atomic_size_t sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    std::size_t reserved;
+    unix::fd eventfd;
+
+    alignas(cache_line) std::atomic_size_t enqueue_pos{0};
+    alignas(cache_line) std::atomic_size_t dequeue_pos{0};
+    alignas(cache_line) std::atomic_size_t discard_until{0};
+    std::atomic_bool consumer_waiting{false};
+    std::atomic_flag dequeue_lock = ATOMIC_FLAG_INIT;
+
+    // fails once limit items are queued, discarded ones included
+    auto enqueue_within(T &&item, std::size_t limit) -> bool
+    {
+        Cell *cell = nullptr;
+        auto pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos & mask];
+            const auto seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                const auto dequeued = dequeue_pos.load(std::memory_order_relaxed);
+                if (dequeued <= pos && pos - dequeued >= limit) {
+                    return false;
+                }
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        wake_consumer();
+        return true;
+    }
+
+    auto dequeue_unlocked() -> std::optional<T>
+    {
+        if (peek_unlocked() == nullptr) {
+            return {};
+        }
+        return take_head();
+    }
+
+    // the oldest item that wasn't discarded, discarded ones in front of it are dropped
+    auto peek_unlocked() -> const T *
+    {
+        while (true) {
+            const auto pos = dequeue_pos.load(std::memory_order_relaxed);
+            auto &cell = cells[pos & mask];
+            if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+                return nullptr;
+            }
+            if (pos >= discard_until.load(std::memory_order_acquire)) {
+                return &cell.data;
+            }
+            take_head();
+        }
+    }
+
+    // only after peek_unlocked found an item, a clear() meanwhile doesn't skip it
+    auto take_head() -> T
+    {
+        const auto pos = dequeue_pos.load(std::memory_order_relaxed);
+        auto &cell = cells[pos & mask];
+        auto item = std::move(cell.data);
+        cell.data = T{};
+        // published by the release below, producers that see the cell free see the new position
+        dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+        cell.sequence.store(pos + mask + 1, std::memory_order_release);
+        return item;
+    }
+
+    void wake_consumer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting.exchange(false, std::memory_order_seq_cst)) {
+            notify();
+        }
+    }
+};
+
+} // namespace upp
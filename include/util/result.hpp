@@ -59,6 +59,8 @@ class Error
         return std::format("{}: {}", prefix, condition.message());
     }
 
+    [[nodiscard]] auto code() const -> const std::error_condition & { return condition; }
+
   private:
     std::string prefix;
     std::error_condition condition;
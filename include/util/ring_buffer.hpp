@@ -0,0 +1,93 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "util/result.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace upp
+{
+
+enum class Framing : std::uint8_t {
+    newline,
+    // every message is preceded by its length as a little endian u32
+    length_prefix,
+};
+
+// Byte ring used to ingest commands from a file descriptor. Incomplete messages
+// are carried over to the next read. Messages are handed out as views into the
+// ring, they're only copied when they wrap around the end of the buffer.
+// Lines are null terminated, messages longer than max_capacity are dropped.
+class RingBuffer
+{
+  public:
+    explicit RingBuffer(Framing framing = Framing::newline, std::size_t initial_capacity = default_capacity);
+
+    // reads everything that is currently available, returns false on end of file
+    auto fill_from_fd(int filde) -> Result<bool>;
+    void clear();
+
+    [[nodiscard]] auto size() const -> std::size_t;
+    [[nodiscard]] auto capacity() const -> std::size_t;
+
+    // views are only valid until the next call
+    auto next_message() -> std::optional<std::string_view>;
+    auto next_line() -> std::optional<std::string_view>;
+    auto next_frame() -> std::optional<std::string_view>;
+
+    template <class Func>
+    void for_each_message(Func &&func)
+    {
+        while (auto message = next_message()) {
+            func(*message);
+        }
+    }
+
+    static constexpr std::size_t default_capacity = 4096;
+    static constexpr std::size_t max_capacity = 1024UL * 1024UL;
+    static constexpr std::size_t length_size = sizeof(std::uint32_t);
+
+  private:
+    std::vector<char> buffer;
+    std::string scratch;
+    Framing framing;
+
+    // monotonic positions, wrapped with mask()
+    std::size_t head = 0;
+    std::size_t tail = 0;
+    // bytes after head that are known not to contain a newline
+    std::size_t scanned = 0;
+    // set when a line exceeded max_capacity, its remainder is dropped
+    bool discarding = false;
+    // bytes of an oversized frame that still have to be dropped
+    std::size_t skip = 0;
+
+    [[nodiscard]] auto mask() const -> std::size_t;
+    void copy_out(std::size_t pos, char *dest, std::size_t length) const;
+    auto take(std::size_t pos, std::size_t length) -> std::string_view;
+    void grow(std::size_t min_capacity);
+};
+
+} // namespace upp
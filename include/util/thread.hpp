@@ -27,11 +27,15 @@
 
 using jthread = std::jthread;
 using stop_token = std::stop_token;
+template <class Callback>
+using stop_callback = std::stop_callback<Callback>;
 #else
 #include "jthread/jthread.hpp"
 
 using jthread = nonstd::jthread;
 using stop_token = nonstd::stop_token;
+template <class Callback>
+using stop_callback = nonstd::stop_callback<Callback>;
 #endif
 // IWYU pragma: end_exports
 
@@ -24,6 +24,7 @@
 #include <charconv>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <print>
@@ -50,7 +51,8 @@ constexpr auto view_to_numeral(const std::string_view view) -> Result<T>
 auto get_filename(std::string_view path) -> std::string;
 auto get_log_filename() -> std::string;
 auto get_cache_path() -> std::filesystem::path;
-auto get_cache_file_save_location(const std::filesystem::path &path) -> std::string;
+// digest identifies the source and the decode, see PixelKey::digest
+auto get_cache_file_save_location(std::uint64_t digest, std::string_view extension) -> std::string;
 auto get_socket_path(int pid = os::getpid()) -> std::string;
 auto temp_directory_path() -> std::filesystem::path;
 
@@ -23,12 +23,17 @@
 #include "command/command.hpp"
 #include "log.hpp"
 #include "util/result.hpp"
-#include "util/str_map.hpp"
-#include "util/thread.hpp"
 #include "wayland/types.hpp"
 #include "wayland/window.hpp"
 
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace upp
 {
@@ -38,11 +43,13 @@ class WaylandCanvas final : public Canvas
   public:
     explicit WaylandCanvas(ApplicationContext *ctx);
     auto init() -> Result<void> override;
-    void execute(const Command &cmd) override;
+    auto execute(const Command &cmd, std::span<Decoded> decoded) -> std::vector<Outcome> override;
 
     static void wl_registry_global(void *data, wl_registry *registry, uint32_t name, const char *interface,
                                    uint32_t version);
     static void xdg_wm_base_ping(void *data, xdg_wm_base *xdg_wm_base, uint32_t serial);
+    static void wl_shm_format(void *data, wl_shm *shm, uint32_t format);
+    static void wl_callback_done(void *data, wl_callback *callback, uint32_t time);
 
   private:
     ApplicationContext *ctx;
@@ -53,12 +60,19 @@ class WaylandCanvas final : public Canvas
     wl::shm shm;
     wl::xdg::wm_base wm_base;
 
-    string_map<std::shared_ptr<WaylandWindow>> window_map;
+    std::unordered_map<PreviewId, std::shared_ptr<WaylandWindow>> window_map;
     WindowPtrs window_ptrs;
+    std::unordered_set<uint32_t> shm_formats;
 
-    jthread event_handler;
+    // frame callbacks the compositor has not answered yet, only compared by address
+    std::unordered_set<wl_callback *> pending_frames;
+    std::mutex frame_mutex;
+    std::condition_variable frame_done;
 
-    void handle_events(SToken token);
+    auto execute_command(const Command &cmd, Decoded &decoded, std::vector<wl::callback> &frames) -> Outcome;
+    void wait_for_frames(std::vector<wl::callback> &frames);
+    void handle_events(std::uint32_t events);
+    void negotiate_pixel_format();
 
     int display_fd = -1;
 };
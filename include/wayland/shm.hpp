@@ -18,28 +18,34 @@
 
 #pragma once
 
-#include "unix/fd.hpp"
+#include "image/pixel_cache.hpp"
+#include "unix/shared_memory.hpp"
 #include "util/result.hpp"
 #include "wayland/types.hpp"
 
+#include <optional>
+
 namespace upp
 {
 
 class WaylandShm
 {
   public:
-    explicit WaylandShm(wl::shm_ptr shm);
-    ~WaylandShm();
-    auto init(int new_width, int new_height, unsigned char *data) -> Result<void>;
+    // format is the wl_shm format of the pixels passed to init
+    WaylandShm(wl::shm_ptr shm, uint32_t format);
+    // the compositor maps the memfd of the image directly, images in private memory are copied once
+    auto init(PixelBufferPtr new_image) -> Result<void>;
     auto get_buffer() -> wl::buffer_ptr;
 
     static void wl_buffer_release(void *data, wl_buffer *buffer);
 
   private:
     wl::shm_ptr shm;
-    unix::fd memfd;
+    uint32_t format;
+    PixelBufferPtr image;
+    std::optional<unix::SharedMemory> copy;
 
-    uint8_t *pool_data = nullptr;
+    int pool_fd = -1;
     int pool_size = 0;
     int width = 0;
     int height = 0;
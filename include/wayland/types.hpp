@@ -33,6 +33,7 @@ struct deleter {
     void operator()(wl_shm *ptr) const { wl_shm_destroy(ptr); }
     void operator()(wl_shm_pool *ptr) const { wl_shm_pool_destroy(ptr); }
     void operator()(wl_surface *ptr) const { wl_surface_destroy(ptr); }
+    void operator()(wl_callback *ptr) const { wl_callback_destroy(ptr); }
 
     void operator()(xdg_wm_base *ptr) const { xdg_wm_base_destroy(ptr); }
     void operator()(xdg_surface *ptr) const { xdg_surface_destroy(ptr); }
@@ -45,6 +46,7 @@ using compositor = std::unique_ptr<wl_compositor, deleter>;
 using shm = std::unique_ptr<wl_shm, deleter>;
 using shm_pool = std::unique_ptr<wl_shm_pool, deleter>;
 using surface = std::unique_ptr<wl_surface, deleter>;
+using callback = std::unique_ptr<wl_callback, deleter>;
 using buffer_ptr = wl_buffer *;
 using shm_ptr = wl_shm *;
 
@@ -19,8 +19,9 @@
 #pragma once
 
 #include "application/context.hpp"
-#include "image/vips.hpp"
+#include "image/decode_pool.hpp"
 #include "command/command.hpp"
+#include "command/response.hpp"
 #include "log.hpp"
 #include "wayland/shm.hpp"
 #include "wayland/types.hpp"
@@ -45,7 +46,10 @@ class WaylandWindow : public std::enable_shared_from_this<WaylandWindow>
 {
   public:
     WaylandWindow(ApplicationContext *ctx, wl_compositor *compositor, wl_shm *shm, xdg_wm_base *wm_base);
-    auto init(const Command &command, WindowPtrs &window_ptrs) -> Result<void>;
+    auto init(const Command &command, PixelBufferPtr new_image, WindowPtrs &window_ptrs, Timings &timings)
+        -> Result<void>;
+    // done once the compositor presented the first buffer of the surface
+    auto frame(const wl_callback_listener *listener, void *data) -> wl::callback;
 
     static void preferred_buffer_scale(void *data, wl_surface *surface, int factor);
     static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial);
@@ -53,7 +57,6 @@ class WaylandWindow : public std::enable_shared_from_this<WaylandWindow>
   private:
     Logger logger{spdlog::get("wayland")};
     ApplicationContext *ctx;
-    LibvipsImage image;
 
     WaylandShm shm;
     wl::surface surface;
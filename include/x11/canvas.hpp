@@ -24,25 +24,27 @@
 #include "log.hpp"
 #include "terminal.hpp"
 #include "util/result.hpp"
-#include "util/str_map.hpp"
-#include "util/thread.hpp"
 #include "x11/window.hpp"
 
+#include <cstdint>
 #include <expected>
 #include <memory>
 #include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
 
 namespace upp
 {
 
-using WindowIdMap = string_map<std::shared_ptr<X11Window>>;
+using WindowIdMap = std::unordered_map<PreviewId, std::shared_ptr<X11Window>>;
 
 class X11Canvas final : public Canvas
 {
   public:
     explicit X11Canvas(ApplicationContext *ctx);
     auto init() -> Result<void> override;
-    void execute(const Command &cmd) override;
+    auto execute(const Command &cmd, std::span<Decoded> decoded) -> std::vector<Outcome> override;
 
   private:
     ApplicationContext *ctx;
@@ -51,11 +53,12 @@ class X11Canvas final : public Canvas
     WindowMap window_map;
     WindowIdMap window_id_map;
     std::mutex window_mutex;
-    jthread event_handler;
 
-    void handle_events(SToken token);
+    auto execute_command(const Command &cmd, Decoded &decoded) -> Outcome;
+    void negotiate_pixel_format();
+    void handle_events(std::uint32_t events);
     void handle_expose_event(xcb_generic_event_t *event);
-    void handle_add_command(const Command &cmd);
+    auto handle_add_command(const Command &cmd, Decoded &decoded, Timings &timings) -> Result<void>;
     void handle_remove_command(const Command &cmd);
     void dispatch_events();
 };
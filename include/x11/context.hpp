@@ -41,6 +41,8 @@ class X11Context
     auto load_state(int pid) -> Result<void>;
     void handle_xcb_error(xcb::error_ptr err) const;
     void flush() const;
+    // returns once the server handled every request sent before
+    void sync() const;
     static constexpr int num_clients = 256;
 
     xcb::connection connection;
@@ -50,6 +52,8 @@ class X11Context
     X11Geometry parent_geometry;
     int connection_fd = -1;
     bool is_xwayland = false;
+    // MIT-SHM 1.2, segments can be attached from an fd
+    bool has_shm_fd = false;
     bool is_valid = false;
 
   private:
@@ -59,6 +63,7 @@ class X11Context
 
     void set_pid_window_map();
     void create_gcontext();
+    void query_shm();
     auto set_parent_window(int pid) -> Result<void>;
     auto set_parent_window_geometry() -> Result<void>;
 
@@ -22,6 +22,7 @@
 
 // IWYU pragma: begin_exports
 #include <xcb/res.h>
+#include <xcb/shm.h>
 #include <xcb/xcb.h>
 #include <xcb/xcb_errors.h>
 #include <xcb/xcb_image.h>
@@ -20,7 +20,8 @@
 
 #include "application/context.hpp"
 #include "command/command.hpp"
-#include "image/vips.hpp"
+#include "command/response.hpp"
+#include "image/decode_pool.hpp"
 #include "x11/types.hpp"
 
 #include <memory>
@@ -39,20 +40,31 @@ class X11Window : public std::enable_shared_from_this<X11Window>
 {
   public:
     X11Window(ApplicationContext *ctx, WindowMap *window_map);
+    ~X11Window();
+    X11Window(const X11Window &) = delete;
+    auto operator=(const X11Window &) -> X11Window & = delete;
     void create_xcb_windows();
     void hide_xcb_windows();
-    auto init(const Command &command) -> Result<void>;
+    // keeps a reference to the pixels, they are drawn until the next init
+    auto init(const Command &command, PixelBufferPtr new_image, Timings &timings) -> Result<void>;
     void draw(xcb::window_id window);
 
   private:
     ApplicationContext *ctx;
     WindowMap *window_map;
-    LibvipsImage image;
+    PixelBufferPtr image;
 
     auto configure_xcb_windows(const Command &command) -> Result<void>;
+    // the server maps the memfd of the image, draws then send no pixels over the socket.
+    // Waits for the server, false when it could not attach the segment
+    auto attach_segment() -> bool;
+    void detach_segment();
+    // callers hold image_mutex
+    void put_image(xcb::window_id window);
 
     xcb::window xcb_window;
     xcb::image xcb_image;
+    xcb_shm_seg_t segment = 0;
     std::mutex image_mutex;
 };
 
@@ -20,11 +20,13 @@
 #include "base/canvas.hpp"
 #include "buildconfig.hpp"
 #include "cli.hpp"
+#include "client/client.hpp"
 #include "os/os.hpp"
-#include "unix/socket.hpp"
 #include "util/result.hpp"
 #include "util/util.hpp"
 
+#include <unistd.h>
+
 #include <CLI/CLI.hpp>
 #include <spdlog/cfg/env.h>
 #include <spdlog/sinks/basic_file_sink.h>
@@ -38,16 +40,43 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <csignal>
 #include <fstream>
+#include <future>
+#include <iterator>
 #include <memory>
+#include <print>
 #include <string>
 #include <string_view>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace upp
 {
 
+namespace
+{
+
+constexpr std::size_t mebibyte = 1024 * 1024;
+
+auto to_mebibytes(std::uint64_t bytes) -> double
+{
+    return static_cast<double>(bytes) / mebibyte;
+}
+
+// nothing refers to a removed preview anymore, unless a command parsed after the remove uses its name
+void release_identifiers(const Command &cmd)
+{
+    if (cmd.action == Action::remove) {
+        Identifiers::release(cmd.preview_id, cmd.identifier_serial);
+    }
+    std::ranges::for_each(cmd.batch, release_identifiers);
+}
+
+} // namespace
+
 Application::Application(Cli *cli) :
     cli(cli)
 {
@@ -62,8 +91,9 @@ auto Application::handle_cli_commands() -> Result<void>
 {
     if (cli->layer_command->parsed()) {
         print_header();
-        setup_signal_handler();
-        return setup_vips()
+        // signals are blocked before vips or any other library starts its threads
+        return setup_signal_handler()
+            .and_then([this] { return setup_vips(); })
             .and_then([this] { return ctx->init(cli->layer.output); })
             .and_then([this] { return daemonize(); })
             .and_then([this] { return Canvas::create(ctx.get()); })
@@ -71,34 +101,118 @@ auto Application::handle_cli_commands() -> Result<void>
                 canvas = std::move(new_canvas);
                 return canvas->init();
             })
-            .and_then([this] { return command_listener.start(cli->layer.parser, cli->layer.no_stdin); })
+            .and_then([this] {
+                setup_caches();
+                decode_pool.emplace(ctx.get(), [this] { queue.notify(); });
+                // commands read from a regular file on stdin are enqueued before the loop runs
+                command_thread = jthread([this](auto token) { execute_layer_commands(token); });
+                return command_listener.start(cli->layer.parser, cli->layer.no_stdin, queue_options());
+            })
             .and_then([this] { return wait_for_layer_commands(); });
     }
     if (cli->cmd_command->parsed()) {
         return handle_cmd_subcommand();
     }
+    if (cli->cache_command->parsed()) {
+        return handle_cache_subcommand();
+    }
 
     return {};
 }
 
 auto Application::handle_cmd_subcommand() -> Result<void>
 {
-    auto payload = cli->cmd.get_json_string();
-    if (payload.empty()) {
-        return {};
-    }
-    unix::socket::Client client;
-    auto result = client.connect_and_write(cli->cmd.socket, util::make_buffer(payload));
+    const auto &cmd = cli->cmd;
+    client::Connection connection{cmd.get_encoding()};
+    auto result = connection.connect(cmd.socket).and_then([&connection, &cmd] {
+        if (cmd.stream) {
+            return connection.forward(STDIN_FILENO);
+        }
+        return connection.send(cmd.get_request()).and_then([&connection, &cmd]() -> Result<void> {
+            if (cmd.request_id.empty()) {
+                return {};
+            }
+            return connection.receive().transform([](const std::string &response) { std::println("{}", response); });
+        });
+    });
     if (!result) {
         LOG_DEBUG("could not send command: {}", result.error().message());
     }
     return {};
 }
 
+void Application::setup_caches()
+{
+    const auto &layer = cli->layer;
+    ctx->cache_policy = layer.no_cache ? CachePolicy::memory_only : DiskCache::policy_from_string(layer.cache_policy);
+    ctx->cache_format = DiskCache::format_from_string(layer.cache_format);
+    const bool use_memory = ctx->cache_policy != CachePolicy::off;
+    ctx->pixel_cache.set_budget(use_memory ? layer.memory_cache_size * mebibyte : 0);
+    if (!reads_disk(ctx->cache_policy)) {
+        return;
+    }
+    const auto directory = util::get_cache_path();
+    if (auto opened = ctx->cache_index.open(directory / CacheIndex::file_name); !opened) {
+        LOG_WARN("cache index unavailable, probing cache files instead: {}", opened.error().message());
+    }
+    if (writes_disk(ctx->cache_policy)) {
+        const CacheBudget budget{.bytes = layer.disk_cache_size * mebibyte, .entries = layer.disk_cache_entries};
+        cache_evictor.emplace(CacheMaintenance{directory, &ctx->cache_index}, budget);
+    }
+}
+
+auto Application::handle_cache_subcommand() -> Result<void>
+{
+    const auto &cache = cli->cache;
+    const auto directory = util::get_cache_path();
+    CacheIndex index;
+    if (auto opened = index.open(directory / CacheIndex::file_name); !opened) {
+        LOG_WARN("cache index unavailable, using file times: {}", opened.error().message());
+    }
+    const CacheMaintenance maintenance{directory, &index};
+    const auto print_removed = [](const CacheUsage &removed) {
+        std::println("removed {} entries, {:.1f} MiB", removed.entries, to_mebibytes(removed.bytes));
+    };
+    if (cache.action == "prune") {
+        const CacheBudget budget{.bytes = cache.disk_cache_size * mebibyte, .entries = cache.disk_cache_entries};
+        return maintenance.prune(budget).transform(print_removed);
+    }
+    if (cache.action == "clear") {
+        return maintenance.clear().transform(print_removed);
+    }
+    return maintenance.usage().transform([&directory, &index](const CacheUsage &usage) {
+        const auto stats = index.stats();
+        const auto lookups = static_cast<double>(stats.hits + stats.misses);
+        const double hit_rate = lookups == 0 ? 0.0 : 100.0 * static_cast<double>(stats.hits) / lookups;
+        std::println("directory: {}", directory.string());
+        std::println("entries: {}, {} in the index", usage.entries, index.snapshot().size());
+        std::println("size: {:.1f} MiB", to_mebibytes(usage.bytes));
+        std::println("lookups: {} hits, {} misses, {:.1f}% hit rate", stats.hits, stats.misses, hit_rate);
+        std::println("evictions: {}", stats.evictions);
+    });
+}
+
+auto Application::queue_options() const -> QueueOptions
+{
+    return {
+        .policy = CommandListener::policy_from_string(cli->layer.queue_policy),
+        .deadline = std::chrono::milliseconds{cli->layer.queue_deadline},
+    };
+}
+
 auto Application::wait_for_layer_commands() -> Result<void>
 {
-    command_thread = jthread([this](auto token) { execute_layer_commands(token); });
-    stop_flag.wait(false);
+    if (auto result = ctx->loop.run(); !result) {
+        LOG_ERROR(result.error().message());
+    }
+    command_thread.request_stop();
+    command_thread.join();
+    const auto stats = command_listener.stats();
+    LOG_INFO("command queue overflows: {} oldest dropped, {} newest dropped, {} blocked, {} timed out while blocked",
+             stats.dropped_oldest, stats.dropped_newest, stats.blocked, stats.block_timeouts);
+    const auto cache_stats = ctx->pixel_cache.stats();
+    LOG_INFO("pixel cache: {} hits, {} misses, {} evictions, {} images in {} bytes", cache_stats.hits,
+             cache_stats.misses, cache_stats.evictions, cache_stats.entries, cache_stats.bytes);
 #ifdef ENABLE_LIBVIPS
     vips_shutdown();
 #endif
@@ -108,14 +222,166 @@ auto Application::wait_for_layer_commands() -> Result<void>
 
 void Application::execute_layer_commands(SToken token)
 {
+    auto wake_queue = [this] { queue.notify(); };
+    const stop_callback<decltype(wake_queue)> stop_wakeup{token, wake_queue};
     while (!token.stop_requested()) {
-        if (auto cmd = queue.try_dequeue(os::waitms)) {
-            std::scoped_lock state_lock{ctx->state_mutex};
-            canvas->execute(*cmd);
-        } else {
+        if (auto result = queue.wait(); !result) {
+            LOG_WARN(result.error().message());
+            terminate();
+            return;
+        }
+        schedule_queued_commands();
+        bool progressed = true;
+        while (progressed && !token.stop_requested()) {
+            progressed = apply_decoded_commands();
+            progressed = finish_prefetches() || progressed;
+            progressed = submit_commands() || progressed;
+            // commands that arrived meanwhile may supersede pending ones
+            schedule_queued_commands();
+        }
+    }
+    ctx->decodes.cancel_all();
+    decode_pool->wait();
+    in_flight.clear();
+    prefetching.clear();
+    const auto stats = scheduler.stats();
+    LOG_INFO("executed {} of {} commands, {} coalesced, {} expired", stats.executed, stats.scheduled, stats.coalesced,
+             stats.expired);
+}
+
+void Application::report_outcomes(const Command &cmd, Clock::time_point started, std::vector<Outcome> &outcomes)
+{
+    const auto report = [this, started](const Command &target, Outcome &outcome) {
+        if (target.request_id.empty()) {
+            return;
+        }
+        outcome.timings.queue_wait = started - target.received;
+        command_listener.respond(Response::from_outcome(target, outcome));
+    };
+    if (cmd.action != Action::batch) {
+        if (!outcomes.empty()) {
+            report(cmd, outcomes.front());
+        }
+        return;
+    }
+    for (std::size_t i = 0; i < std::min(cmd.batch.size(), outcomes.size()); ++i) {
+        report(cmd.batch[i], outcomes[i]);
+    }
+}
+
+void Application::schedule_queued_commands()
+{
+    while (auto cmd = queue.try_dequeue()) {
+        scheduler.schedule(std::move(*cmd));
+    }
+}
+
+auto Application::submit_commands() -> bool
+{
+    // commands left in the scheduler can still be coalesced, so only take as many as can decode at once
+    bool submitted = false;
+    while (std::cmp_less(in_flight.size(), decode_pool->concurrency())) {
+        auto cmd = scheduler.next();
+        if (!cmd) {
+            break;
+        }
+        submit_command(std::move(*cmd));
+        submitted = true;
+    }
+    // the scheduler holds prefetches back while other commands are pending
+    while (std::cmp_less(prefetching.size(), decode_pool->concurrency())) {
+        auto cmd = scheduler.next_prefetch();
+        if (!cmd) {
+            break;
+        }
+        std::scoped_lock state_lock{ctx->state_mutex};
+        auto &entry = prefetching.emplace_back(InFlight{.cmd = std::move(*cmd), .started = Clock::now()});
+        entry.decodes.push_back(decode_pool->submit(entry.cmd));
+        submitted = true;
+    }
+    return submitted;
+}
+
+void Application::submit_command(Command &&cmd)
+{
+    auto &entry = in_flight.emplace_back(InFlight{.cmd = std::move(cmd), .started = Clock::now()});
+    const auto submit = [this](const Command &target) {
+        return target.action == Action::add ? decode_pool->submit(target) : std::future<Decoded>{};
+    };
+    std::scoped_lock state_lock{ctx->state_mutex};
+    if (entry.cmd.action == Action::batch) {
+        std::ranges::transform(entry.cmd.batch, std::back_inserter(entry.decodes), submit);
+    } else {
+        entry.decodes.push_back(submit(entry.cmd));
+    }
+}
+
+auto Application::apply_decoded_commands() -> bool
+{
+    const auto is_decoded = [](const InFlight &entry) {
+        return std::ranges::all_of(entry.decodes, [](const std::future<Decoded> &decode) {
+            return !decode.valid() || decode.wait_for(std::chrono::seconds::zero()) == std::future_status::ready;
+        });
+    };
+    // previews apply in command order, but a slow decode only holds back its own identifier.
+    // Batches and commands without an identifier wait for everything before them
+    bool applied = false;
+    std::unordered_set<PreviewId> blocked;
+    auto entry = in_flight.begin();
+    while (entry != in_flight.end()) {
+        const bool is_barrier = entry->cmd.action == Action::batch || entry->cmd.preview_id == no_preview;
+        if (is_barrier && entry != in_flight.begin()) {
+            break;
+        }
+        if (blocked.contains(entry->cmd.preview_id) || !is_decoded(*entry)) {
+            if (is_barrier) {
+                break;
+            }
+            blocked.insert(entry->cmd.preview_id);
+            ++entry;
             continue;
         }
+        apply_command(*entry);
+        entry = in_flight.erase(entry);
+        applied = true;
+    }
+    return applied;
+}
+
+auto Application::finish_prefetches() -> bool
+{
+    const auto finished = std::erase_if(prefetching, [this](InFlight &entry) {
+        auto &decode = entry.decodes.front();
+        if (decode.wait_for(std::chrono::seconds::zero()) != std::future_status::ready) {
+            return false;
+        }
+        auto decoded = decode.get();
+        Outcome outcome{.result = {}, .timings = {.decode = decoded.elapsed}};
+        if (!decoded.image) {
+            LOG_DEBUG("could not prefetch {}: {}", entry.cmd.image_path.string(), decoded.image.error().message());
+            outcome.result = std::unexpected(decoded.image.error());
+        }
+        std::vector<Outcome> outcomes{std::move(outcome)};
+        report_outcomes(entry.cmd, entry.started, outcomes);
+        return true;
+    });
+    return finished > 0;
+}
+
+void Application::apply_command(InFlight &entry)
+{
+    std::vector<Decoded> decoded;
+    decoded.reserve(entry.decodes.size());
+    std::ranges::transform(entry.decodes, std::back_inserter(decoded), [](std::future<Decoded> &decode) {
+        return decode.valid() ? decode.get() : Decoded{};
+    });
+    std::vector<Outcome> outcomes;
+    {
+        std::scoped_lock state_lock{ctx->state_mutex};
+        outcomes = canvas->execute(entry.cmd, decoded);
     }
+    release_identifiers(entry.cmd);
+    report_outcomes(entry.cmd, entry.started, outcomes);
 }
 
 void Application::print_header()
@@ -170,6 +436,7 @@ auto Application::setup_logging() -> Result<void>
         spdlog::initialize_logger(listener);
         spdlog::initialize_logger(wayland);
         spdlog::initialize_logger(hyprland);
+        spdlog::initialize_logger(socket);
 
         spdlog::set_default_logger(logger);
     } catch (const spdlog::spdlog_ex &ex) {
@@ -194,27 +461,23 @@ auto Application::setup_vips() -> Result<void>
 
 void Application::terminate()
 {
-    stop_flag.test_and_set();
-    stop_flag.notify_one();
+    ApplicationContext::get()->loop.stop();
 }
 
-void Application::setup_signal_handler()
+auto Application::setup_signal_handler() -> Result<void>
 {
     LOG_DEBUG("setting up signal handler");
-    struct sigaction sga{};
-    sga.sa_handler = signal_handler;
-    sigemptyset(&sga.sa_mask);
-    sga.sa_flags = 0;
-    sigaction(SIGINT, &sga, nullptr);
-    sigaction(SIGTERM, &sga, nullptr);
-    sigaction(SIGHUP, &sga, nullptr);
-    sigaction(SIGCHLD, nullptr, nullptr);
-
-    struct sigaction sgaw{};
-    sgaw.sa_handler = sigwinch_handler;
-    sigemptyset(&sgaw.sa_mask);
-    sgaw.sa_flags = 0;
-    sigaction(SIGWINCH, &sgaw, nullptr);
+    auto &loop = ctx->loop;
+    return loop.init().and_then([&loop] {
+        // delivered through a signalfd, so the handlers run on the event loop
+        return loop.add_signals({SIGINT, SIGTERM, SIGHUP, SIGWINCH}, [](int signal) {
+            if (signal == SIGWINCH) {
+                sigwinch_handler(signal);
+            } else {
+                signal_handler(signal);
+            }
+        });
+    });
 }
 
 void Application::signal_handler(int signal)
@@ -18,34 +18,32 @@
 
 #include "cli.hpp"
 #include "buildconfig.hpp"
+#include "client/client.hpp"
 
 #include <CLI/CLI.hpp>
 
 namespace upp::subcommands
 {
 
-auto cmd::get_json_string() const -> std::string
+auto cmd::get_request() const -> client::Request
 {
-    if (action == "exit" || action == "flush") {
-        return std::format(
-            R"({{"action":"{}"}}
-)",
-            action);
-    }
-    if (action == "remove") {
-        return std::format(
-            R"({{"action":"remove","identifier":"{}"}}
-)",
-            identifier);
-    }
-    if (action == "add") {
-        return std::format(
-            R"({{"action":"add","identifier":"{}","width":{},"height":{},"x":{},"y":{},"path":"{}","scaler":"{}"}}
-)",
-            identifier, width, height, x, y, file_path, scaler);
-    }
+    return {
+        .action = action_from_string(action),
+        .identifier = identifier,
+        .file_path = file_path,
+        .scaler = scaler,
+        .request_id = request_id,
+        .x = x,
+        .y = y,
+        .width = width,
+        .height = height,
+        .deadline_ms = deadline_ms,
+    };
+}
 
-    return {};
+auto cmd::get_encoding() const -> client::Encoding
+{
+    return parser == "binary" ? client::Encoding::binary : client::Encoding::json;
 }
 
 } // namespace upp::subcommands
@@ -61,6 +59,7 @@ Cli::Cli()
 
     setup_layer_subcommand();
     setup_cmd_subcommand();
+    setup_cache_subcommand();
 
     auto *query_win_command =
         program.add_subcommand("query_windows", "**UNUSED**, only present for backwards compatibility");
@@ -77,21 +76,67 @@ void Cli::setup_layer_subcommand()
     layer_command->add_flag("--no-stdin", layer.no_stdin, "Do not listen on stdin for commands")
         ->default_val(false)
         ->needs("--pid-file");
-    layer_command->add_flag("--no-cache", layer.no_cache, "Disable caching of resized images")->default_val(false);
+    auto *cache_policy =
+        layer_command
+            ->add_option("--cache-policy", layer.cache_policy,
+                         "Which caches are used, read-only never writes the disk cache, off disables both")
+            ->check(CLI::IsMember({"off", "read-only", "memory-only", "read-write"}))
+            ->default_str("read-write");
+    layer_command
+        ->add_flag("--no-cache", layer.no_cache, "Disable caching of resized images on disk, same as memory-only")
+        ->default_val(false)
+        ->excludes(cache_policy);
     layer_command->add_option("-o,--output", layer.output, "Image output method")
         ->check(CLI::IsMember({"x11", "wayland", "sixel", "kitty", "iterm2", "chafa"}));
     layer_command->add_flag("--origin-center", layer.origin_center, "Location of the origin wrt the image")
         ->default_val(false);
     layer_command->add_option("-p,--parser", layer.parser, "Command parser to use")
-        ->check(CLI::IsMember({"json", "bash", "simple"}))
+        ->check(CLI::IsMember({"json", "bash", "simple", "binary"}))
         ->default_str("json");
+    layer_command->add_option("--queue-capacity", layer.queue_capacity, "Maximum number of pending commands")
+        ->check(CLI::Range(1, 1 << 20))
+        ->default_str("1024");
+    layer_command->add_option("--queue-policy", layer.queue_policy, "What to do with commands when the queue is full")
+        ->check(CLI::IsMember({"drop-oldest", "drop-newest", "block"}))
+        ->default_str("drop-oldest");
+    layer_command
+        ->add_option("--queue-deadline", layer.queue_deadline,
+                     "Drop commands that waited longer than this many milliseconds, 0 disables it")
+        ->check(CLI::NonNegativeNumber)
+        ->default_str("0");
+    layer_command
+        ->add_option("--memory-cache-size", layer.memory_cache_size,
+                     "MiB of decoded images kept in memory, 0 disables it")
+        ->default_str("256");
+    layer_command
+        ->add_option("--cache-format", layer.cache_format,
+                     "How resized images are cached on disk, raw and qoi store display ready pixels")
+        ->check(CLI::IsMember({"image", "raw", "qoi"}))
+        ->default_str("image");
+    layer_command
+        ->add_option("--disk-cache-size", layer.disk_cache_size,
+                     "MiB the disk cache is trimmed to in the background, 0 disables the limit")
+        ->default_str("1024");
+    layer_command
+        ->add_option("--disk-cache-entries", layer.disk_cache_entries,
+                     "Entries the disk cache is trimmed to in the background, 0 disables the limit")
+        ->default_str("0");
     layer_command->add_option("-l,--loader", nullptr, "**UNUSED**, only present for backwards compatibility");
 }
 
 void Cli::setup_cmd_subcommand()
 {
     cmd_command->add_option("-s,--socket", cmd.socket, "unix socket of running instance")->required();
-    cmd_command->add_option("-a,--action", cmd.action, "action to send")->required();
+    auto *action = cmd_command->add_option("-a,--action", cmd.action, "action to send");
+    cmd_command
+        ->add_flag("--stdin", cmd.stream, "Keep the connection open and forward commands read from stdin")
+        ->default_val(false)
+        ->excludes(action);
+    cmd_command->callback([this] {
+        if (!cmd.stream && cmd.action.empty()) {
+            throw CLI::RequiredError("--action");
+        }
+    });
     cmd_command->add_option("-i,--identifier", cmd.identifier, "preview identifier");
     cmd_command->add_option("-f,--file", cmd.file_path, "path of image file");
     cmd_command->add_option("-x,--xpos", cmd.x, "x position of preview");
@@ -99,6 +144,31 @@ void Cli::setup_cmd_subcommand()
     cmd_command->add_option("--max-width", cmd.width, "max width of preview");
     cmd_command->add_option("--max-height", cmd.height, "max height of preview");
     cmd_command->add_option("--scaler", cmd.scaler, "scaler to use")->default_str("contain");
+    cmd_command
+        ->add_option("--deadline", cmd.deadline_ms,
+                     "Drop the command when it waited longer than this many milliseconds, 0 uses the queue deadline")
+        ->check(CLI::NonNegativeNumber);
+    cmd_command->add_option("-r,--request-id", cmd.request_id,
+                            "Wait for the command to be executed and print the response");
+    cmd_command->add_option("-p,--parser", cmd.parser, "Encoding to use, must match the parser of the instance")
+        ->check(CLI::IsMember({"json", "binary"}))
+        ->default_str("json");
+}
+
+void Cli::setup_cache_subcommand()
+{
+    cache_command
+        ->add_option("action", cache.action,
+                     "stats prints the size and hit rate, prune trims the cache to the limits, clear empties it")
+        ->check(CLI::IsMember({"stats", "prune", "clear"}))
+        ->required();
+    cache_command
+        ->add_option("--disk-cache-size", cache.disk_cache_size, "MiB prune trims the cache to, 0 disables the limit")
+        ->default_str("1024");
+    cache_command
+        ->add_option("--disk-cache-entries", cache.disk_cache_entries,
+                     "Entries prune trims the cache to, 0 disables the limit")
+        ->default_str("0");
 }
 
 } // namespace upp
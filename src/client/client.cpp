@@ -0,0 +1,168 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "client/client.hpp"
+#include "command/binary.hpp"
+#include "util/json.hpp"
+
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <format>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace upp::client
+{
+
+namespace
+{
+
+auto encode_json(const Request &request) -> Result<std::string>
+{
+    auto result = make_result<std::string>(R"({"action":)");
+    auto &out = *result;
+    util::append_json_string(out, action_to_string(request.action));
+    if (!request.request_id.empty()) {
+        out.append(R"(,"request_id":)");
+        util::append_json_string(out, request.request_id);
+    }
+    if (request.deadline_ms > 0) {
+        std::format_to(std::back_inserter(out), R"(,"deadline_ms":{})", request.deadline_ms);
+    }
+    switch (request.action) {
+        case Action::exit:
+        case Action::flush:
+        case Action::begin:
+        case Action::commit:
+            break;
+        case Action::remove:
+            out.append(R"(,"identifier":)");
+            util::append_json_string(out, request.identifier);
+            break;
+        case Action::add:
+        case Action::prefetch:
+            out.append(R"(,"identifier":)");
+            util::append_json_string(out, request.identifier);
+            std::format_to(std::back_inserter(out), R"(,"width":{},"height":{},"x":{},"y":{},"path":)",
+                           request.width, request.height, request.x, request.y);
+            util::append_json_string(out, request.file_path);
+            out.append(R"(,"scaler":)");
+            util::append_json_string(out, request.scaler);
+            break;
+        default:
+            return Err(std::format("can't encode {} action", action_to_string(request.action)), 0);
+    }
+    out.append("}\n");
+    return result;
+}
+
+auto as_bytes(std::string_view view) -> std::span<const std::byte>
+{
+    return std::as_bytes(std::span{view.data(), view.size()});
+}
+
+} // namespace
+
+auto encode(const Request &request, Encoding encoding) -> Result<std::string>
+{
+    if (encoding == Encoding::binary) {
+        return binary::encode({
+            .action = request.action,
+            .identifier = request.identifier,
+            .scaler = request.scaler,
+            .path = request.file_path,
+            .request_id = request.request_id,
+            .x = request.x,
+            .y = request.y,
+            .width = request.width,
+            .height = request.height,
+            .deadline_ms = request.deadline_ms,
+        });
+    }
+    return encode_json(request);
+}
+
+Connection::Connection(Encoding encoding) :
+    encoding(encoding)
+{
+}
+
+auto Connection::connect(std::string_view endpoint) -> Result<void>
+{
+    return socket.connect(endpoint);
+}
+
+auto Connection::send(const Request &request) const -> Result<void>
+{
+    return encode(request, encoding).and_then([this](const std::string &payload) { return send_raw(payload); });
+}
+
+auto Connection::send_raw(std::string_view payload) const -> Result<void>
+{
+    return socket.write(as_bytes(payload));
+}
+
+auto Connection::forward(int filde) const -> Result<void>
+{
+    // the instance reassembles lines and frames, so chunks can be sent as they arrive
+    constexpr std::size_t chunk_size = 65536;
+    std::array<char, chunk_size> chunk;
+    while (true) {
+        const auto bytes_read = ::read(filde, chunk.data(), chunk.size());
+        if (bytes_read == 0) {
+            return {};
+        }
+        if (bytes_read == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return Err("could not read commands");
+        }
+        if (auto result = send_raw({chunk.data(), static_cast<std::size_t>(bytes_read)}); !result) {
+            return result;
+        }
+    }
+}
+
+auto Connection::receive() -> Result<std::string>
+{
+    constexpr std::size_t chunk_size = 4096;
+    std::array<std::byte, chunk_size> chunk;
+    while (true) {
+        if (const auto end = received.find('\n'); end != std::string::npos) {
+            auto line = make_result<std::string>(received, 0, end);
+            received.erase(0, end + 1);
+            return line;
+        }
+        auto bytes_read = socket.read_some(chunk);
+        if (!bytes_read) {
+            return std::unexpected(bytes_read.error());
+        }
+        if (*bytes_read == 0) {
+            return Err("connection closed", 0);
+        }
+        received.append(reinterpret_cast<const char *>(chunk.data()), *bytes_read);
+    }
+}
+
+} // namespace upp::client
@@ -0,0 +1,150 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "command/binary.hpp"
+#include "util/result.hpp"
+
+#include <bit>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace upp::binary
+{
+
+namespace
+{
+
+template <class T>
+auto to_little(T value) -> T
+{
+    if constexpr (std::endian::native == std::endian::big) {
+        return std::byteswap(value);
+    }
+    return value;
+}
+
+template <class T>
+void put(std::string &out, T value)
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        put(out, std::bit_cast<std::uint32_t>(value));
+    } else {
+        value = to_little(value);
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+}
+
+template <class T>
+auto get(std::string_view &in) -> T
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        return std::bit_cast<T>(get<std::uint32_t>(in));
+    } else {
+        T value{};
+        std::memcpy(&value, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return to_little(value);
+    }
+}
+
+} // namespace
+
+auto encode(const Frame &frame) -> Result<std::string>
+{
+    if (frame.action == Action::none) {
+        return Err("unknown action", 0);
+    }
+
+    constexpr auto max_u16 = std::numeric_limits<std::uint16_t>::max();
+    if (frame.identifier.size() > max_u16 || frame.scaler.size() > max_u16 || frame.request_id.size() > max_u16) {
+        return Err("identifier, scaler or request id too long", 0);
+    }
+    const auto payload_size =
+        header_size + frame.identifier.size() + frame.scaler.size() + frame.path.size() + frame.request_id.size();
+    if (payload_size > std::numeric_limits<std::uint32_t>::max()) {
+        return Err("path too long", 0);
+    }
+
+    auto result = make_result<std::string>();
+    result->reserve(sizeof(std::uint32_t) + payload_size);
+    put(*result, static_cast<std::uint32_t>(payload_size));
+    put(*result, protocol_version);
+    put(*result, std::to_underlying(frame.action));
+    put(*result, static_cast<std::uint16_t>(frame.identifier.size()));
+    put(*result, static_cast<std::uint16_t>(frame.scaler.size()));
+    put(*result, static_cast<std::uint16_t>(frame.request_id.size()));
+    put(*result, static_cast<std::uint32_t>(frame.path.size()));
+    put(*result, static_cast<std::int32_t>(frame.x));
+    put(*result, static_cast<std::int32_t>(frame.y));
+    put(*result, static_cast<std::int32_t>(frame.width));
+    put(*result, static_cast<std::int32_t>(frame.height));
+    put(*result, frame.scaling_position_x);
+    put(*result, frame.scaling_position_y);
+    put(*result, static_cast<std::int32_t>(frame.deadline_ms));
+    result->append(frame.identifier);
+    result->append(frame.scaler);
+    result->append(frame.path);
+    result->append(frame.request_id);
+    return result;
+}
+
+auto decode(std::string_view payload) -> Result<Frame>
+{
+    if (payload.size() < header_size) {
+        return Err("binary frame too short", 0);
+    }
+    if (const auto version = get<std::uint8_t>(payload); version != protocol_version) {
+        return Err(std::format("unsupported binary protocol version {}", version), 0);
+    }
+
+    const auto action_id = get<std::uint8_t>(payload);
+    const auto action = static_cast<Action>(action_id);
+    if (action_to_string(action) == "none") {
+        return Err(std::format("unknown binary action {}", action_id), 0);
+    }
+
+    auto frame = make_result<Frame>();
+    frame->action = action;
+    const std::size_t identifier_size = get<std::uint16_t>(payload);
+    const std::size_t scaler_size = get<std::uint16_t>(payload);
+    const std::size_t request_id_size = get<std::uint16_t>(payload);
+    const std::size_t path_size = get<std::uint32_t>(payload);
+    frame->x = get<std::int32_t>(payload);
+    frame->y = get<std::int32_t>(payload);
+    frame->width = get<std::int32_t>(payload);
+    frame->height = get<std::int32_t>(payload);
+    frame->scaling_position_x = get<float>(payload);
+    frame->scaling_position_y = get<float>(payload);
+    frame->deadline_ms = get<std::int32_t>(payload);
+
+    if (payload.size() != identifier_size + scaler_size + path_size + request_id_size) {
+        return Err("binary frame size mismatch", 0);
+    }
+    frame->identifier = payload.substr(0, identifier_size);
+    frame->scaler = payload.substr(identifier_size, scaler_size);
+    frame->path = payload.substr(identifier_size + scaler_size, path_size);
+    frame->request_id = payload.substr(identifier_size + scaler_size + path_size);
+    return frame;
+}
+
+} // namespace upp::binary
@@ -17,13 +17,16 @@
 // along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "command/command.hpp"
+#include "command/binary.hpp"
 #include "util/result.hpp"
 
 #include <glaze/glaze.hpp>
 
+#include <algorithm>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 template <>
 struct glz::meta<upp::Command> {
@@ -42,12 +45,22 @@ struct glz::meta<upp::Command> {
     template <auto MemberPointer>
     static constexpr auto custom_int = custom<maybe_quoted_int_read<MemberPointer>, MemberPointer>;
 
+    static constexpr auto read_action = [](T &self, const std::string &value) {
+        self.action = upp::action_from_string(value);
+    };
+
+    static constexpr auto read_identifier = [](T &self, const std::string &value) {
+        self.preview_id = upp::Identifiers::intern(value);
+    };
+
     // NOLINTNEXTLINE
     static constexpr auto value = object(
         // clang-format off
-        &T::action,
-        "identifier", &T::preview_id,
+        "action", custom<read_action, &T::action>,
+        "identifier", custom<read_identifier, &T::preview_id>,
         "scaler", &T::image_scaler,
+        "request_id", &T::request_id,
+        "deadline_ms", custom_int<&T::deadline_ms>,
         "path", &T::image_path,
         "x", custom_int<&T::x>,
         "y", custom_int<&T::y>,
@@ -64,16 +77,36 @@ struct glz::meta<upp::Command> {
 namespace upp
 {
 
-auto Command::create(std::string_view parser, std::string line) -> Result<Command>
+auto Command::create(std::string_view parser, std::string_view line) -> Result<Command>
 {
     if (parser == "json") {
-        return from_json(std::move(line));
+        return from_json(line);
+    }
+    if (parser == "binary") {
+        return from_binary(line);
+    }
+    if (parser == "simple") {
+        return from_simple(line);
+    }
+    if (parser == "bash") {
+        return from_bash(line);
     }
 
     return {};
 }
 
-auto Command::from_json(std::string line) -> Result<Command>
+auto Command::from_json(std::string_view line) -> Result<Command>
+{
+    if (const auto start = line.find_first_not_of(" \t\r"); start != std::string_view::npos && line[start] == '[') {
+        return from_json_array(line);
+    }
+    if (auto cmd = from_json_fast(line)) {
+        return std::move(*cmd);
+    }
+    return from_json_generic(line);
+}
+
+auto Command::from_json_generic(std::string_view line) -> Result<Command>
 {
     auto cmd = make_result<Command>();
     if (auto err = glz::read<glz::opts{.error_on_unknown_keys = 0}>(*cmd, line)) {
@@ -85,4 +118,47 @@ auto Command::from_json(std::string line) -> Result<Command>
     return cmd;
 }
 
+auto Command::from_json_array(std::string_view line) -> Result<Command>
+{
+    std::vector<Command> commands;
+    if (auto err = glz::read<glz::opts{.error_on_unknown_keys = 0}>(commands, line)) {
+        return Err(glz::format_error(err, line));
+    }
+    for (auto &cmd : commands) {
+        if (cmd.image_scaler.empty()) {
+            cmd.image_scaler = "contain";
+        }
+    }
+    return Command{.action = Action::batch, .batch = std::move(commands)};
+}
+
+auto Command::from_binary(std::string_view frame) -> Result<Command>
+{
+    return binary::decode(frame).transform([](const binary::Frame &decoded) {
+        Command cmd{
+            .action = decoded.action,
+            .preview_id = Identifiers::intern(decoded.identifier),
+            .image_scaler = std::string{decoded.scaler},
+            .image_path = decoded.path,
+            .x = decoded.x,
+            .y = decoded.y,
+            .width = decoded.width,
+            .height = decoded.height,
+            .scaling_position_x = decoded.scaling_position_x,
+            .scaling_position_y = decoded.scaling_position_y,
+            .request_id = std::string{decoded.request_id},
+            .deadline_ms = decoded.deadline_ms,
+        };
+        if (cmd.image_scaler.empty()) {
+            cmd.image_scaler = "contain";
+        }
+        return cmd;
+    });
+}
+
+auto Command::wants_response() const -> bool
+{
+    return !request_id.empty() || std::ranges::any_of(batch, &Command::wants_response);
+}
+
 } // namespace upp
@@ -0,0 +1,116 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "command/identifier.hpp"
+#include "util/str_map.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace upp
+{
+
+namespace
+{
+
+struct Interned {
+    PreviewId preview_id = no_preview;
+    // serial of the latest intern of the name, updated under the shared lock
+    std::atomic_uint64_t last_serial{0};
+};
+
+struct IdentifierTable {
+    std::shared_mutex mutex;
+    string_map<Interned> ids;
+    std::unordered_map<PreviewId, std::string> names;
+    PreviewId next_id = 1;
+    std::atomic_uint64_t serial{0};
+};
+
+auto table() -> IdentifierTable &
+{
+    static IdentifierTable instance;
+    return instance;
+}
+
+} // namespace
+
+auto Identifiers::intern(std::string_view name) -> PreviewId
+{
+    if (name.empty()) {
+        return no_preview;
+    }
+    auto &tbl = table();
+    const auto serial = tbl.serial.fetch_add(1, std::memory_order_relaxed) + 1;
+    {
+        std::shared_lock lock{tbl.mutex};
+        if (auto found = tbl.ids.find(name); found != tbl.ids.end()) {
+            found->second.last_serial.store(serial, std::memory_order_relaxed);
+            return found->second.preview_id;
+        }
+    }
+    std::unique_lock lock{tbl.mutex};
+    auto [found, inserted] = tbl.ids.try_emplace(std::string{name});
+    if (inserted) {
+        found->second.preview_id = tbl.next_id++;
+        tbl.names.emplace(found->second.preview_id, name);
+    }
+    found->second.last_serial.store(serial, std::memory_order_relaxed);
+    return found->second.preview_id;
+}
+
+auto Identifiers::name(PreviewId preview_id) -> std::string
+{
+    if (preview_id == no_preview) {
+        return {};
+    }
+    auto &tbl = table();
+    std::shared_lock lock{tbl.mutex};
+    auto found = tbl.names.find(preview_id);
+    return found != tbl.names.end() ? found->second : std::string{};
+}
+
+auto Identifiers::serial() -> std::uint64_t
+{
+    return table().serial.load(std::memory_order_relaxed);
+}
+
+void Identifiers::release(PreviewId preview_id, std::uint64_t serial)
+{
+    if (preview_id == no_preview) {
+        return;
+    }
+    auto &tbl = table();
+    std::unique_lock lock{tbl.mutex};
+    auto name = tbl.names.find(preview_id);
+    if (name == tbl.names.end()) {
+        return;
+    }
+    auto interned = tbl.ids.find(name->second);
+    if (interned->second.last_serial.load(std::memory_order_relaxed) > serial) {
+        return;
+    }
+    tbl.ids.erase(interned);
+    tbl.names.erase(name);
+}
+
+} // namespace upp
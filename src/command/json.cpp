@@ -0,0 +1,291 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "command/command.hpp"
+#include "command/identifier.hpp"
+#include "util/result.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace upp
+{
+
+namespace
+{
+
+auto skip_digits(std::string_view &token) -> std::size_t
+{
+    std::size_t count = 0;
+    while (count < token.size() && token[count] >= '0' && token[count] <= '9') {
+        ++count;
+    }
+    token.remove_prefix(count);
+    return count;
+}
+
+// the json number grammar, which from_chars is more lenient than
+auto is_json_number(std::string_view token) -> bool
+{
+    if (!token.empty() && token.front() == '-') {
+        token.remove_prefix(1);
+    }
+    const bool leading_zero = !token.empty() && token.front() == '0';
+    const auto integer_digits = skip_digits(token);
+    if (integer_digits == 0 || (leading_zero && integer_digits > 1)) {
+        return false;
+    }
+    if (!token.empty() && token.front() == '.') {
+        token.remove_prefix(1);
+        if (skip_digits(token) == 0) {
+            return false;
+        }
+    }
+    if (!token.empty() && (token.front() == 'e' || token.front() == 'E')) {
+        token.remove_prefix(1);
+        if (!token.empty() && (token.front() == '+' || token.front() == '-')) {
+            token.remove_prefix(1);
+        }
+        if (skip_digits(token) == 0) {
+            return false;
+        }
+    }
+    return token.empty();
+}
+
+// single pass reader for flat command objects, any shape it doesn't
+// understand makes it bail out so the generic parser can handle it
+class FastReader
+{
+  public:
+    explicit FastReader(std::string_view input) :
+        input(input)
+    {
+    }
+
+    auto read(Command &cmd) -> bool
+    {
+        skip_whitespace();
+        if (!consume('{')) {
+            return false;
+        }
+        skip_whitespace();
+        if (consume('}')) {
+            return at_end();
+        }
+        while (true) {
+            std::string_view key;
+            skip_whitespace();
+            if (!read_string(key)) {
+                return false;
+            }
+            skip_whitespace();
+            if (!consume(':')) {
+                return false;
+            }
+            skip_whitespace();
+            if (!read_member(cmd, key)) {
+                return false;
+            }
+            skip_whitespace();
+            if (consume(',')) {
+                continue;
+            }
+            return consume('}') && at_end();
+        }
+    }
+
+  private:
+    std::string_view input;
+
+    void skip_whitespace()
+    {
+        while (!input.empty() && (input.front() == ' ' || input.front() == '\t' || input.front() == '\r' ||
+                                  input.front() == '\n')) {
+            input.remove_prefix(1);
+        }
+    }
+
+    auto consume(char chr) -> bool
+    {
+        if (input.empty() || input.front() != chr) {
+            return false;
+        }
+        input.remove_prefix(1);
+        return true;
+    }
+
+    auto at_end() -> bool
+    {
+        skip_whitespace();
+        return input.empty();
+    }
+
+    // strings with escapes are left to the generic parser
+    auto read_string(std::string_view &value) -> bool
+    {
+        if (!consume('"')) {
+            return false;
+        }
+        const auto *quote = static_cast<const char *>(std::memchr(input.data(), '"', input.size()));
+        if (quote == nullptr) {
+            return false;
+        }
+        const auto length = static_cast<std::size_t>(quote - input.data());
+        if (std::memchr(input.data(), '\\', length) != nullptr) {
+            return false;
+        }
+        value = input.substr(0, length);
+        input.remove_prefix(length + 1);
+        return true;
+    }
+
+    auto read_token(std::string_view &value) -> bool
+    {
+        std::size_t length = 0;
+        while (length < input.size() && input[length] != ',' && input[length] != '}' && input[length] != ' ' &&
+               input[length] != '\t' && input[length] != '\r' && input[length] != '\n') {
+            ++length;
+        }
+        value = input.substr(0, length);
+        input.remove_prefix(length);
+        return length != 0;
+    }
+
+    // numbers may be quoted or not
+    template <class T>
+    auto read_number(T &field, bool allow_quoted) -> bool
+    {
+        std::string_view token;
+        const bool is_quoted = !input.empty() && input.front() == '"';
+        if (is_quoted ? !(allow_quoted && read_string(token)) : !(read_token(token) && is_json_number(token))) {
+            return false;
+        }
+        T number{};
+        auto [ptr, err] = std::from_chars(token.data(), token.data() + token.size(), number);
+        if (err != std::errc() || ptr != token.data() + token.size()) {
+            return false;
+        }
+        field = number;
+        return true;
+    }
+
+    auto skip_value() -> bool
+    {
+        std::string_view ignored;
+        if (!input.empty() && input.front() == '"') {
+            return read_string(ignored);
+        }
+        if (!input.empty() && (input.front() == '{' || input.front() == '[')) {
+            return false;
+        }
+        return read_token(ignored) &&
+               (ignored == "true" || ignored == "false" || ignored == "null" || is_json_number(ignored));
+    }
+
+    auto read_member(Command &cmd, std::string_view key) -> bool
+    {
+        std::string_view value;
+        if (key == "action") {
+            if (!read_string(value)) {
+                return false;
+            }
+            cmd.action = action_from_string(value);
+        } else if (key == "identifier") {
+            if (!read_string(value)) {
+                return false;
+            }
+            cmd.preview_id = Identifiers::intern(value);
+        } else if (key == "scaler") {
+            if (!read_string(value)) {
+                return false;
+            }
+            cmd.image_scaler = value;
+        } else if (key == "path") {
+            if (!read_string(value)) {
+                return false;
+            }
+            cmd.image_path = value;
+        } else if (key == "request_id") {
+            if (!read_string(value)) {
+                return false;
+            }
+            cmd.request_id = value;
+        } else if (key == "deadline_ms") {
+            return read_number(cmd.deadline_ms, true);
+        } else if (key == "x") {
+            return read_number(cmd.x, true);
+        } else if (key == "y") {
+            return read_number(cmd.y, true);
+        } else if (key == "width" || key == "max_width") {
+            return read_number(cmd.width, true);
+        } else if (key == "height" || key == "max_height") {
+            return read_number(cmd.height, true);
+        } else if (key == "scaling_position_x") {
+            return read_number(cmd.scaling_position_x, false);
+        } else if (key == "scaling_position_y") {
+            return read_number(cmd.scaling_position_y, false);
+        } else {
+            return skip_value();
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+auto Command::from_json_fast(std::string_view line) -> std::optional<Command>
+{
+    Command cmd;
+    if (!FastReader{line}.read(cmd)) {
+        return {};
+    }
+    if (cmd.image_scaler.empty()) {
+        cmd.image_scaler = "contain";
+    }
+    return cmd;
+}
+
+auto Command::from_json_lines(std::string_view buffer) -> std::vector<Result<Command>>
+{
+    std::vector<Result<Command>> result;
+    while (!buffer.empty()) {
+        const auto end = std::min(buffer.find('\n'), buffer.size());
+        const auto line = buffer.substr(0, end);
+        buffer.remove_prefix(std::min(end + 1, buffer.size()));
+        if (line.empty()) {
+            continue;
+        }
+        if (auto cmd = from_json_fast(line)) {
+            result.emplace_back(std::move(*cmd));
+        } else {
+            // arrays and the generic parser need a null terminated buffer
+            result.emplace_back(from_json(std::string{line}));
+        }
+    }
+    return result;
+}
+
+} // namespace upp
@@ -18,126 +18,377 @@
 
 #include "application/application.hpp"
 #include "command/command.hpp"
-#include "os/os.hpp"
 #include "util/result.hpp"
 
+#include <unistd.h>
+
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <ranges>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace upp
 {
 
+namespace
+{
+
+void stamp(Command &cmd, std::uint64_t source, Clock::time_point received, std::uint64_t serial)
+{
+    cmd.source = source;
+    cmd.received = received;
+    cmd.identifier_serial = serial;
+    for (auto &child : cmd.batch) {
+        stamp(child, source, received, serial);
+    }
+}
+
+// how long a blocked producer sleeps before retrying
+constexpr auto block_interval = std::chrono::microseconds{200};
+
+} // namespace
+
 CommandListener::CommandListener(CommandQueue *queue) :
     queue(queue)
 {
 }
 
-auto CommandListener::start(std::string_view new_parser, bool no_stdin) -> Result<void>
+auto CommandListener::start(std::string_view new_parser, bool no_stdin, QueueOptions new_options) -> Result<void>
 {
     logger = spdlog::get("listener");
     parser = new_parser;
+    options = new_options;
     LOG_INFO("using {} parser", parser);
-    if (!no_stdin) {
-        stdin_thread = jthread([this](auto token) { wait_for_input_on_stdin(token); });
-    }
-    return socket_server.start().and_then([this]() -> Result<void> {
-        socket_thread = jthread([this](auto token) { wait_for_input_on_socket(token); });
-        return {};
-    });
+    LOG_DEBUG("command queue holds {} commands", queue->capacity());
+    const auto framing = parser == "binary" ? Framing::length_prefix : Framing::newline;
+    stdin_buffer = RingBuffer{framing};
+    return socket_server.start(framing)
+        .and_then([this] {
+            LOG_INFO("listening for commands on socket {}", socket_server.get_endpoint());
+            return ctx->loop.add(socket_server.get_fd(), [this](std::uint32_t) { read_from_socket(); });
+        })
+        .and_then([this] {
+            responses.arm();
+            return ctx->loop.add(responses.get_fd(), [this](std::uint32_t) { send_responses(); });
+        })
+        .and_then([this, no_stdin] { return no_stdin ? Result<void>{} : listen_on_stdin(); });
 }
 
-void CommandListener::wait_for_input_on_stdin(SToken token)
+auto CommandListener::listen_on_stdin() -> Result<void>
 {
     LOG_INFO("listening for commands on stdin");
-    // failing to wait or read data from stdin is fatal
-    while (!token.stop_requested()) {
-        if (auto in_event = os::wait_for_data_on_stdin()) {
-            if (!*in_event) {
-                continue;
+    if (auto result = ctx->loop.add(STDIN_FILENO, [this](std::uint32_t) { read_from_stdin(); })) {
+        return {};
+    }
+    if (errno != EPERM) {
+        return Err("could not listen on stdin");
+    }
+    // regular files can't be polled but are always readable
+    while (read_from_stdin()) {
+    }
+    return {};
+}
+
+auto CommandListener::read_from_stdin() -> bool
+{
+    // failing to read data from stdin is fatal
+    auto is_open = stdin_buffer.fill_from_fd(STDIN_FILENO);
+    stdin_buffer.for_each_message([this](std::string_view line) { parse_command(stdin_source, line); });
+    if (!is_open) {
+        LOG_WARN("could not read data from stdin: {}", is_open.error().message());
+    } else if (!*is_open) {
+        LOG_INFO("stdin closed");
+    } else {
+        return true;
+    }
+    ctx->loop.remove(STDIN_FILENO);
+    Application::terminate();
+    return false;
+}
+
+void CommandListener::read_from_socket()
+{
+    auto result = socket_server.read_data_from_connections(
+        [this](unix::socket::ConnectionId source, std::string_view line) { parse_command(source, line); },
+        [this](unix::socket::ConnectionId source) { discard_batch(source); });
+    if (!result) {
+        LOG_DEBUG("could not read data from connections: {}", result.error().message());
+    }
+}
+
+void CommandListener::respond(Response &&response)
+{
+    if (response.request_id.empty() || response.source == stdin_source) {
+        return;
+    }
+    if (!responses.try_enqueue(std::move(response))) {
+        LOG_WARN("response queue is full, dropping response");
+    }
+}
+
+auto CommandListener::stats() const -> ListenerStats
+{
+    return {
+        .dropped_oldest = dropped_oldest.load(std::memory_order_relaxed),
+        .dropped_newest = dropped_newest.load(std::memory_order_relaxed),
+        .blocked = blocked.load(std::memory_order_relaxed),
+        .block_timeouts = block_timeouts.load(std::memory_order_relaxed),
+    };
+}
+
+auto CommandListener::policy_from_string(std::string_view policy) -> OverflowPolicy
+{
+    if (policy == "drop-newest") {
+        return OverflowPolicy::drop_newest;
+    }
+    if (policy == "block") {
+        return OverflowPolicy::block;
+    }
+    return OverflowPolicy::drop_oldest;
+}
+
+void CommandListener::send_responses()
+{
+    responses.acknowledge();
+    do {
+        while (auto response = responses.try_dequeue()) {
+            if (auto result = socket_server.send(response->source, response->to_json()); !result) {
+                LOG_DEBUG("could not send response {}: {}", response->request_id, result.error().message());
             }
-        } else {
-            LOG_WARN("could not wait for data from stdin: {}", in_event.error().message());
-            Application::terminate();
-            return;
         }
-        if (auto data = os::read_data_from_stdin()) {
-            extract_commands(*data);
-        } else {
-            LOG_WARN("could not read data from stdin: {}", data.error().message());
-            Application::terminate();
-            return;
+    } while (!responses.arm());
+}
+
+void CommandListener::parse_command(std::uint64_t source, std::string_view line)
+{
+    if (line.empty()) {
+        return;
+    }
+    if (parser != "binary") {
+        LOG_TRACE("Received command: {}", line);
+    }
+    if (auto cmd = Command::create(parser, line)) {
+        stamp(*cmd, source, Clock::now(), Identifiers::serial());
+        switch (cmd->action) {
+            case Action::exit:
+                acknowledge(*cmd);
+                // the loop stops before it would send the response
+                send_responses();
+                Application::terminate();
+                break;
+            case Action::flush:
+                flush_command_queue();
+                acknowledge(*cmd);
+                break;
+            case Action::begin:
+                begin_batch(source);
+                acknowledge(*cmd);
+                break;
+            case Action::commit:
+                acknowledge(*cmd, commit_batch(source));
+                break;
+            case Action::batch:
+                // binary frames can't carry the commands of a batch
+                if (parser == "binary") {
+                    LOG_ERROR("received batch over the binary protocol");
+                    acknowledge(*cmd, Err("batch is not supported by the binary protocol, use begin and commit", 0));
+                    break;
+                }
+                enqueue_batch(std::move(*cmd));
+                break;
+            case Action::none:
+                LOG_ERROR("received command without a valid action");
+                acknowledge(*cmd, Err("command without a valid action", 0));
+                break;
+            default:
+                add_command(source, std::move(*cmd));
+                break;
         }
+    } else {
+        LOG_ERROR(cmd.error().message());
     }
 }
 
-void CommandListener::wait_for_input_on_socket(SToken token)
+void CommandListener::acknowledge(const Command &cmd, Result<void> result)
 {
-    LOG_INFO("listening for commands on socket {}", socket_server.get_endpoint());
-    // it is only fatal to wait for data from socket
-    while (!token.stop_requested()) {
-        if (auto in_event = os::wait_for_data_on_fd(socket_server.get_fd())) {
-            if (!*in_event) {
-                continue;
-            }
-        } else {
-            LOG_WARN("could not wait for data from socket: {}", in_event.error().message());
-            Application::terminate(); // stop this program if this thread dies
+    respond(Response::from_outcome(cmd, Outcome{.result = std::move(result)}));
+}
+
+void CommandListener::flush_command_queue()
+{
+    LOG_DEBUG("flushing command queue");
+    ctx->decodes.cancel_all();
+    // the scheduler discards everything before the marker and answers pending requests.
+    // The reserved cells are only taken while earlier markers are still queued
+    Command marker{.action = Action::flush};
+    while (!queue->try_enqueue_reserved(std::move(marker))) {
+        if (ctx->loop.is_stopped()) {
             return;
         }
-        if (auto data = socket_server.read_data_from_connection()) {
-            extract_commands(*data);
-        } else {
-            LOG_DEBUG("could not read data from connection: {}", data.error().message());
-        }
+        std::this_thread::sleep_for(block_interval);
     }
 }
 
-void CommandListener::extract_commands(std::string_view line)
+void CommandListener::enqueue(Command &&cmd)
 {
-    while (true) {
-        const auto find_result = line.find('\n');
-        if (find_result == std::string_view::npos) {
+    cancel_superseded_decodes(cmd);
+    set_deadline(cmd);
+    if (queue->try_enqueue(std::move(cmd))) {
+        return;
+    }
+    switch (options.policy) {
+        case OverflowPolicy::drop_oldest:
+            evict_oldest();
+            if (queue->try_enqueue(std::move(cmd))) {
+                return;
+            }
+            // a flush marker is the oldest command, this one is dropped in its place
+            dropped_oldest.fetch_add(1, std::memory_order_relaxed);
             break;
-        }
-
-        auto cmd_str = line.substr(0, find_result);
-        LOG_TRACE("Received command: {}", cmd_str);
-        if (auto cmd = Command::create(parser, std::string{cmd_str})) {
-            if (cmd->action == "exit") {
-                Application::terminate();
-            } else if (cmd->action == "flush") {
-                flush_command_queue();
-            } else {
-                enqueue_or_discard(*cmd);
+        case OverflowPolicy::block:
+            if (wait_for_space(cmd)) {
+                return;
             }
-        } else {
-            LOG_ERROR(cmd.error().message());
+            block_timeouts.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case OverflowPolicy::drop_newest:
+            dropped_newest.fetch_add(1, std::memory_order_relaxed);
+            break;
+    }
+    LOG_WARN("command queue is full, dropping command");
+    respond_dropped(cmd, Clock::now() < cmd.deadline ? Status::dropped : Status::expired);
+}
+
+void CommandListener::set_deadline(Command &cmd) const
+{
+    if (cmd.action == Action::batch) {
+        // a batch executes as a whole, it expires with its most urgent child
+        for (auto &child : cmd.batch) {
+            set_deadline(child);
+            cmd.deadline = std::min(cmd.deadline, child.deadline);
         }
-        line.remove_prefix(find_result + 1);
+        return;
+    }
+    const auto deadline = cmd.deadline_ms > 0 ? std::chrono::milliseconds{cmd.deadline_ms} : options.deadline;
+    if (deadline.count() > 0) {
+        cmd.deadline = cmd.received + deadline;
     }
-};
+}
 
-void CommandListener::flush_command_queue() const
+void CommandListener::evict_oldest()
 {
-    LOG_DEBUG("flushing command queue");
-    queue->clear();
+    // a flush marker is never evicted or moved, it discards what was queued before it
+    auto oldest = queue->try_dequeue_if([](const Command &cmd) { return cmd.action != Action::flush; });
+    if (!oldest) {
+        return;
+    }
+    LOG_DEBUG("command queue is full, dropping oldest command");
+    dropped_oldest.fetch_add(1, std::memory_order_relaxed);
+    respond_dropped(*oldest, Status::dropped);
 }
 
-void CommandListener::enqueue_or_discard(const Command &cmd)
+auto CommandListener::wait_for_space(Command &cmd) -> bool
 {
-    queue->enqueue(cmd, [this, &cmd](auto &deque) {
-        if (deque.size() <= 2 || cmd.action != "remove") {
+    // holding the event loop stops reading from clients, which fills their socket buffers
+    blocked.fetch_add(1, std::memory_order_relaxed);
+    while (!ctx->loop.is_stopped() && Clock::now() < cmd.deadline) {
+        std::this_thread::sleep_for(block_interval);
+        if (queue->try_enqueue(std::move(cmd))) {
             return true;
         }
-        if (auto &last = deque.back(); last.action == "add" && last.preview_id == cmd.preview_id) {
-            LOG_INFO("discarding add/remove command pair for {}", last.image_path.filename().string());
-            deque.pop_back();
-            return false;
+    }
+    return false;
+}
+
+void CommandListener::respond_dropped(const Command &cmd, Status status)
+{
+    if (cmd.action == Action::batch) {
+        std::ranges::for_each(cmd.batch, [this, status](const Command &child) { respond_dropped(child, status); });
+        return;
+    }
+    respond(Response::dropped(cmd, status));
+}
+
+void CommandListener::cancel_superseded_decodes(const Command &cmd)
+{
+    if (cmd.action == Action::batch) {
+        std::ranges::for_each(cmd.batch, [this](const Command &inner) { cancel_superseded_decodes(inner); });
+        return;
+    }
+    // a prefetch never replaces what a preview shows
+    if (cmd.action == Action::prefetch) {
+        return;
+    }
+    if (cmd.preview_id != no_preview && ctx->decodes.cancel(cmd.preview_id)) {
+        LOG_DEBUG("cancelling decode for superseded {}", Identifiers::name(cmd.preview_id));
+    }
+}
+
+void CommandListener::add_command(std::uint64_t source, Command &&cmd)
+{
+    if (auto pending = pending_batches.find(source); pending != pending_batches.end()) {
+        pending->second.batch.push_back(std::move(cmd));
+        return;
+    }
+    enqueue(std::move(cmd));
+}
+
+void CommandListener::begin_batch(std::uint64_t source)
+{
+    auto [pending, inserted] = pending_batches.try_emplace(source, Command{.action = Action::batch});
+    if (!inserted) {
+        LOG_WARN("batch already open, discarding {} commands", pending->second.batch.size());
+        pending->second.batch.clear();
+    }
+}
+
+auto CommandListener::commit_batch(std::uint64_t source) -> Result<void>
+{
+    auto pending = pending_batches.find(source);
+    if (pending == pending_batches.end()) {
+        LOG_WARN("received commit without begin");
+        return Err("commit without begin", 0);
+    }
+    auto batch = std::move(pending->second);
+    pending_batches.erase(pending);
+    enqueue_batch(std::move(batch));
+    return {};
+}
+
+void CommandListener::discard_batch(std::uint64_t source)
+{
+    if (auto pending = pending_batches.find(source); pending != pending_batches.end()) {
+        LOG_DEBUG("discarding uncommitted batch of {} commands", pending->second.batch.size());
+        pending_batches.erase(pending);
+    }
+}
+
+void CommandListener::enqueue_batch(Command &&batch)
+{
+    // only commands that change the canvas can be batched, prefetches are queued on their own
+    auto [first, last] = std::ranges::stable_partition(
+        batch.batch, [](const Command &cmd) { return cmd.action == Action::add || cmd.action == Action::remove; });
+    for (auto &cmd : std::ranges::subrange(first, last)) {
+        if (cmd.action == Action::prefetch) {
+            enqueue(std::move(cmd));
+        } else {
+            LOG_WARN("ignoring {} command inside batch", action_to_string(cmd.action));
         }
-        return true;
-    });
+    }
+    batch.batch.erase(first, last);
+    if (batch.batch.empty()) {
+        return;
+    }
+    LOG_DEBUG("enqueuing batch of {} commands", batch.batch.size());
+    enqueue(std::move(batch));
 }
 
 } // namespace upp
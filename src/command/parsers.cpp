@@ -0,0 +1,331 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "command/command.hpp"
+#include "util/result.hpp"
+#include "util/util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <format>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+namespace upp
+{
+
+namespace
+{
+
+constexpr std::string_view blanks = " \t\n";
+
+// every possible byte, used to hand out unescaped characters as views
+constexpr auto byte_table = [] {
+    std::array<char, 256> table{};
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        table[i] = static_cast<char>(i);
+    }
+    return table;
+}();
+
+auto byte_view(unsigned char byte) -> std::string_view
+{
+    return {&byte_table[byte], 1};
+}
+
+// joins the pieces of a shell word, only copies when there is more than one
+class WordBuilder
+{
+  public:
+    explicit WordBuilder(std::string &scratch) :
+        scratch(scratch)
+    {
+        scratch.clear();
+    }
+
+    void add(std::string_view piece)
+    {
+        if (piece.empty()) {
+            return;
+        }
+        if (pieces == 0) {
+            first = piece;
+        } else {
+            if (pieces == 1) {
+                scratch.assign(first);
+            }
+            scratch.append(piece);
+        }
+        ++pieces;
+    }
+
+    [[nodiscard]] auto view() const -> std::string_view { return pieces > 1 ? std::string_view{scratch} : first; }
+
+  private:
+    std::string &scratch;
+    std::string_view first;
+    int pieces = 0;
+};
+
+auto assign_number(auto &field, std::string_view key, std::string_view value) -> Result<void>
+{
+    using T = std::remove_reference_t<decltype(field)>;
+    if (auto number = util::view_to_numeral<T>(value)) {
+        field = *number;
+        return {};
+    }
+    return Err(std::format("invalid {}: {}", key, value), 0);
+}
+
+auto assign_field(Command &cmd, std::string_view key, std::string_view value) -> Result<void>
+{
+    if (key == "action") {
+        cmd.action = action_from_string(value);
+    } else if (key == "identifier") {
+        cmd.preview_id = Identifiers::intern(value);
+    } else if (key == "scaler") {
+        cmd.image_scaler = value;
+    } else if (key == "path") {
+        cmd.image_path = value;
+    } else if (key == "request_id") {
+        cmd.request_id = value;
+    } else if (key == "deadline_ms") {
+        return assign_number(cmd.deadline_ms, key, value);
+    } else if (key == "x") {
+        return assign_number(cmd.x, key, value);
+    } else if (key == "y") {
+        return assign_number(cmd.y, key, value);
+    } else if (key == "width" || key == "max_width") {
+        return assign_number(cmd.width, key, value);
+    } else if (key == "height" || key == "max_height") {
+        return assign_number(cmd.height, key, value);
+    } else if (key == "scaling_position_x") {
+        return assign_number(cmd.scaling_position_x, key, value);
+    } else if (key == "scaling_position_y") {
+        return assign_number(cmd.scaling_position_y, key, value);
+    }
+    return {};
+}
+
+auto read_ansi_c_escape(std::string_view &input, WordBuilder &word) -> Result<void>
+{
+    constexpr int hex_base = 16;
+    constexpr int octal_base = 8;
+    const char chr = input.front();
+    input.remove_prefix(1);
+    switch (chr) {
+        case 'a':
+            word.add(byte_view('\a'));
+            break;
+        case 'b':
+            word.add(byte_view('\b'));
+            break;
+        case 'e':
+        case 'E':
+            word.add(byte_view('\x1b'));
+            break;
+        case 'f':
+            word.add(byte_view('\f'));
+            break;
+        case 'n':
+            word.add(byte_view('\n'));
+            break;
+        case 'r':
+            word.add(byte_view('\r'));
+            break;
+        case 't':
+            word.add(byte_view('\t'));
+            break;
+        case 'v':
+            word.add(byte_view('\v'));
+            break;
+        case 'x': {
+            const auto digits = input.substr(0, std::min(input.find_first_not_of("0123456789abcdefABCDEF"), 2UL));
+            int byte = 0;
+            if (std::from_chars(digits.data(), digits.data() + digits.size(), byte, hex_base).ec != std::errc()) {
+                return Err("invalid hex escape in bash command", 0);
+            }
+            word.add(byte_view(static_cast<unsigned char>(byte)));
+            input.remove_prefix(digits.size());
+            break;
+        }
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7': {
+            int byte = chr - '0';
+            for (int i = 0; i < 2 && !input.empty() && input.front() >= '0' && input.front() <= '7'; ++i) {
+                byte = (byte * octal_base) + (input.front() - '0');
+                input.remove_prefix(1);
+            }
+            word.add(byte_view(static_cast<unsigned char>(byte)));
+            break;
+        }
+        default:
+            // \\ \' \" and unknown escapes keep the character
+            word.add(std::string_view{input.data() - 1, 1});
+            break;
+    }
+    return {};
+}
+
+// reads a single shell word, unquoting and unescaping it in one pass
+auto read_shell_word(std::string_view &input, std::string &scratch) -> Result<std::string_view>
+{
+    WordBuilder word{scratch};
+    while (!input.empty() && blanks.find(input.front()) == std::string_view::npos) {
+        const char chr = input.front();
+        if (chr == '\'') {
+            const auto close = input.find('\'', 1);
+            if (close == std::string_view::npos) {
+                return Err("unterminated single quote in bash command", 0);
+            }
+            word.add(input.substr(1, close - 1));
+            input.remove_prefix(close + 1);
+        } else if (chr == '"') {
+            input.remove_prefix(1);
+            while (true) {
+                const auto pos = input.find_first_of("\"\\");
+                if (pos == std::string_view::npos || (input[pos] == '\\' && pos + 1 == input.size())) {
+                    return Err("unterminated double quote in bash command", 0);
+                }
+                word.add(input.substr(0, pos));
+                if (input[pos] == '"') {
+                    input.remove_prefix(pos + 1);
+                    break;
+                }
+                constexpr std::string_view escapable = "\"\\$`";
+                if (const char next = input[pos + 1]; escapable.find(next) != std::string_view::npos) {
+                    word.add(input.substr(pos + 1, 1));
+                } else if (next != '\n') {
+                    word.add(input.substr(pos, 2));
+                }
+                input.remove_prefix(pos + 2);
+            }
+        } else if (chr == '$' && input.size() > 1 && input[1] == '\'') {
+            input.remove_prefix(2);
+            while (true) {
+                const auto pos = input.find_first_of("'\\");
+                if (pos == std::string_view::npos || (input[pos] == '\\' && pos + 1 == input.size())) {
+                    return Err("unterminated ansi-c quote in bash command", 0);
+                }
+                word.add(input.substr(0, pos));
+                const char found = input[pos];
+                input.remove_prefix(pos + 1);
+                if (found == '\'') {
+                    break;
+                }
+                if (auto result = read_ansi_c_escape(input, word); !result) {
+                    return std::unexpected(result.error());
+                }
+            }
+        } else if (chr == '\\') {
+            if (input.size() < 2) {
+                return Err("trailing backslash in bash command", 0);
+            }
+            word.add(input.substr(1, 1));
+            input.remove_prefix(2);
+        } else {
+            auto end = input.find_first_of(" \t\n'\"\\$", 1);
+            end = std::min(end, input.size());
+            word.add(input.substr(0, end));
+            input.remove_prefix(end);
+        }
+    }
+    return word.view();
+}
+
+} // namespace
+
+auto Command::from_simple(std::string_view line) -> Result<Command>
+{
+    auto cmd = make_result<Command>();
+    while (!line.empty()) {
+        const auto key_end = line.find('\t');
+        if (key_end == std::string_view::npos) {
+            return Err(std::format("missing value for key {}", line), 0);
+        }
+        const auto key = line.substr(0, key_end);
+        line.remove_prefix(key_end + 1);
+
+        const auto value_end = std::min(line.find('\t'), line.size());
+        const auto value = line.substr(0, value_end);
+        line.remove_prefix(std::min(value_end + 1, line.size()));
+
+        if (auto result = assign_field(*cmd, key, value); !result) {
+            return std::unexpected(result.error());
+        }
+    }
+    if (cmd->image_scaler.empty()) {
+        cmd->image_scaler = "contain";
+    }
+    return cmd;
+}
+
+auto Command::from_bash(std::string_view line) -> Result<Command>
+{
+    // accepts the output of declare -p for an associative array, e.g.
+    // declare -A cmd=([action]="add" [identifier]="preview" [path]="/some/image.png" )
+    const auto start = line.find('(');
+    const auto end = line.rfind(')');
+    if (start == std::string_view::npos || end == std::string_view::npos || end < start) {
+        return Err("invalid bash command, expected an associative array", 0);
+    }
+    auto body = line.substr(start + 1, end - start - 1);
+
+    thread_local std::string scratch;
+    auto cmd = make_result<Command>();
+    while (true) {
+        body.remove_prefix(std::min(body.find_first_not_of(blanks), body.size()));
+        if (body.empty()) {
+            break;
+        }
+
+        const auto key_end = body.find("]=");
+        if (body.front() != '[' || key_end == std::string_view::npos) {
+            return Err(std::format("invalid bash array entry: {}", body), 0);
+        }
+        auto key = body.substr(1, key_end - 1);
+        if (key.size() >= 2 && key.front() == '"' && key.back() == '"') {
+            key = key.substr(1, key.size() - 2);
+        }
+        body.remove_prefix(key_end + 2);
+
+        auto value = read_shell_word(body, scratch);
+        if (!value) {
+            return std::unexpected(value.error());
+        }
+        if (auto result = assign_field(*cmd, key, *value); !result) {
+            return std::unexpected(result.error());
+        }
+    }
+    if (cmd->image_scaler.empty()) {
+        cmd->image_scaler = "contain";
+    }
+    return cmd;
+}
+
+} // namespace upp
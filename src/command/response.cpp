@@ -0,0 +1,94 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "command/response.hpp"
+#include "util/json.hpp"
+
+#include <array>
+#include <chrono>
+#include <format>
+#include <iterator>
+#include <system_error>
+#include <utility>
+
+namespace upp
+{
+
+namespace
+{
+
+constexpr auto status_names =
+    std::to_array<std::string_view>({"ok", "failed", "superseded", "discarded", "dropped", "expired"});
+
+auto micros(Clock::duration duration) -> std::int64_t
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+} // namespace
+
+auto Response::from_outcome(const Command &cmd, const Outcome &outcome) -> Response
+{
+    Response response{
+        .source = cmd.source,
+        .request_id = cmd.request_id,
+        .status = outcome.result ? Status::ok : Status::failed,
+        .error = {},
+        .timings = outcome.timings,
+    };
+    if (outcome.result) {
+        return response;
+    }
+    // a newer command for the same preview cancelled the decode
+    if (outcome.result.error().code() == std::errc::operation_canceled) {
+        response.status = Status::superseded;
+    } else {
+        response.error = outcome.result.error().message();
+    }
+    return response;
+}
+
+auto Response::dropped(const Command &cmd, Status status) -> Response
+{
+    return {
+        .source = cmd.source,
+        .request_id = cmd.request_id,
+        .status = status,
+        .error = {},
+        .timings = {.queue_wait = Clock::now() - cmd.received},
+    };
+}
+
+auto Response::to_json() const -> std::string
+{
+    std::string out{R"({"request_id":)"};
+    util::append_json_string(out, request_id);
+    out.append(R"(,"status":)");
+    util::append_json_string(out, status_names.at(std::to_underlying(status)));
+    if (!error.empty()) {
+        out.append(R"(,"error":)");
+        util::append_json_string(out, error);
+    }
+    std::format_to(std::back_inserter(out), R"(,"queue_us":{},"decode_us":{},"upload_us":{},"present_us":{}}})",
+                   micros(timings.queue_wait), micros(timings.decode), micros(timings.upload),
+                   micros(timings.present));
+    out.push_back('\n');
+    return out;
+}
+
+} // namespace upp
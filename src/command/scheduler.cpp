@@ -0,0 +1,127 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "command/scheduler.hpp"
+
+#include <optional>
+#include <utility>
+
+namespace upp
+{
+
+CommandScheduler::CommandScheduler(DropCallback on_drop) :
+    on_drop(std::move(on_drop))
+{
+}
+
+void CommandScheduler::schedule(Command &&cmd)
+{
+    scheduled.fetch_add(1, std::memory_order_relaxed);
+    if (cmd.action == Action::flush) {
+        clear();
+        return;
+    }
+    if (cmd.action == Action::prefetch) {
+        if (prefetches.size() >= max_prefetches) {
+            on_drop(prefetches.front(), Status::superseded);
+            prefetches.pop_front();
+            coalesced.fetch_add(1, std::memory_order_relaxed);
+        }
+        prefetches.push_back(std::move(cmd));
+        return;
+    }
+    if (cmd.action == Action::batch || cmd.preview_id == no_preview) {
+        // later commands must not jump ahead of a barrier
+        latest.clear();
+        pending.push_back(std::move(cmd));
+        return;
+    }
+    if (auto found = latest.find(cmd.preview_id); found != latest.end()) {
+        on_drop(*found->second, Status::superseded);
+        *found->second = std::move(cmd);
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    latest.emplace(cmd.preview_id, pending.insert(pending.end(), std::move(cmd)));
+}
+
+auto CommandScheduler::next() -> std::optional<Command>
+{
+    return take_next(pending);
+}
+
+auto CommandScheduler::next_prefetch() -> std::optional<Command>
+{
+    if (!pending.empty()) {
+        return {};
+    }
+    return take_next(prefetches);
+}
+
+auto CommandScheduler::take_next(CommandList &list) -> std::optional<Command>
+{
+    const auto now = Clock::now();
+    while (!list.empty()) {
+        auto node = list.begin();
+        if (&list == &pending) {
+            if (auto found = latest.find(node->preview_id); found != latest.end() && found->second == node) {
+                latest.erase(found);
+            }
+        }
+        auto cmd = std::move(*node);
+        list.erase(node);
+        if (now > cmd.deadline) {
+            on_drop(cmd, Status::expired);
+            expired.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        executed.fetch_add(1, std::memory_order_relaxed);
+        return cmd;
+    }
+    return {};
+}
+
+void CommandScheduler::clear()
+{
+    for (const auto &cmd : pending) {
+        on_drop(cmd, Status::discarded);
+    }
+    for (const auto &cmd : prefetches) {
+        on_drop(cmd, Status::discarded);
+    }
+    latest.clear();
+    pending.clear();
+    prefetches.clear();
+}
+
+auto CommandScheduler::empty() const -> bool
+{
+    return pending.empty() && prefetches.empty();
+}
+
+auto CommandScheduler::stats() const -> SchedulerStats
+{
+    return {
+        .scheduled = scheduled.load(std::memory_order_relaxed),
+        .coalesced = coalesced.load(std::memory_order_relaxed),
+        .executed = executed.load(std::memory_order_relaxed),
+        .expired = expired.load(std::memory_order_relaxed),
+    };
+}
+
+} // namespace upp
@@ -0,0 +1,348 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "image/cache_index.hpp"
+#include "unix/fd.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <system_error>
+#include <utility>
+
+namespace upp
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> magic = {'U', 'P', 'P', 'I', 'D', 'X', '\0', '\1'};
+constexpr std::size_t header_size = 64;
+// a writer that died mid update leaves its slot locked, readers and writers give up on it
+constexpr int max_spins = 64;
+
+struct IndexHeader {
+    std::array<char, 8> magic{};
+    std::uint64_t slot_count = 0;
+    std::uint64_t slot_size = 0;
+};
+
+// the counters follow the header in the same page
+constexpr std::size_t counters_offset = 32;
+
+static_assert(sizeof(IndexHeader) <= counters_offset);
+
+// digest zero marks a free slot
+auto stored_digest(std::uint64_t digest) -> std::uint64_t
+{
+    return digest == 0 ? 1 : digest;
+}
+
+auto now() -> std::int64_t
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+template <class T>
+auto load(T &field) -> T
+{
+    return std::atomic_ref<T>{field}.load(std::memory_order_relaxed);
+}
+
+template <class T>
+void store(T &field, T value)
+{
+    std::atomic_ref<T>{field}.store(value, std::memory_order_relaxed);
+}
+
+void add(std::uint64_t &field, std::uint64_t value)
+{
+    std::atomic_ref{field}.fetch_add(value, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// every field is only accessed through std::atomic_ref, other processes map the same memory
+struct CacheIndex::Slot {
+    // odd while a writer updates the slot
+    std::uint64_t sequence;
+    std::uint64_t digest;
+    std::uint64_t size;
+    std::int64_t last_access;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t channels;
+    std::uint32_t format;
+
+    // a consistent copy of the slot, its digest is stored in key
+    auto read(std::uint64_t &seq, std::uint64_t &key) -> std::optional<CacheIndexEntry>
+    {
+        for (int spin = 0; spin < max_spins; ++spin) {
+            seq = std::atomic_ref{sequence}.load(std::memory_order_acquire);
+            if ((seq & 1U) != 0) {
+                continue;
+            }
+            key = load(digest);
+            const CacheIndexEntry entry{
+                .width = static_cast<int>(load(width)),
+                .height = static_cast<int>(load(height)),
+                .channels = static_cast<int>(load(channels)),
+                .format = static_cast<CacheFormat>(load(format)),
+                .size = load(size),
+                .last_access = load(last_access),
+            };
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (std::atomic_ref{sequence}.load(std::memory_order_relaxed) == seq) {
+                return entry;
+            }
+        }
+        return {};
+    }
+
+    // fails when another writer holds the slot or changed it since seq was read
+    auto write(std::uint64_t seq, std::uint64_t new_digest, const CacheIndexEntry &entry) -> bool
+    {
+        if (!std::atomic_ref{sequence}.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire)) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        store(digest, new_digest);
+        store(size, entry.size);
+        store(last_access, entry.last_access);
+        store(width, static_cast<std::uint32_t>(entry.width));
+        store(height, static_cast<std::uint32_t>(entry.height));
+        store(channels, static_cast<std::uint32_t>(entry.channels));
+        store(format, static_cast<std::uint32_t>(std::to_underlying(entry.format)));
+        std::atomic_ref{sequence}.store(seq + 2, std::memory_order_release);
+        return true;
+    }
+};
+
+struct CacheIndex::Counters {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t evictions;
+};
+
+static_assert(std::atomic_ref<std::uint64_t>::is_always_lock_free);
+
+CacheIndex::~CacheIndex()
+{
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+auto CacheIndex::open(const std::filesystem::path &path) -> Result<void>
+{
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    const unix::fd file{::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)};
+    if (!file) {
+        return Err("open");
+    }
+    // only held while the file is created, lookups never lock
+    if (flock(file.get(), LOCK_EX) == -1) {
+        return Err("flock");
+    }
+    static_assert(counters_offset + sizeof(Counters) <= header_size);
+    const std::size_t size = header_size + (slot_count * sizeof(Slot));
+    struct stat info {};
+    if (fstat(file.get(), &info) == -1) {
+        return Err("fstat");
+    }
+    const bool is_new = info.st_size == 0;
+    if (is_new && ftruncate(file.get(), static_cast<off_t>(size)) == -1) {
+        return Err("ftruncate");
+    }
+    if (!is_new && static_cast<std::size_t>(info.st_size) != size) {
+        // another version owns the file, resizing it would fault the daemons that mapped it
+        return Err("cache index has an unknown layout", 0);
+    }
+    auto *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file.get(), 0);
+    if (address == MAP_FAILED) {
+        return Err("mmap");
+    }
+    const IndexHeader expected{.magic = magic, .slot_count = slot_count, .slot_size = sizeof(Slot)};
+    // a creator that died before writing the header leaves it zeroed
+    constexpr IndexHeader unwritten{};
+    if (is_new || std::memcmp(address, &unwritten, sizeof(unwritten)) == 0) {
+        std::memcpy(address, &expected, sizeof(expected));
+    } else if (std::memcmp(address, &expected, sizeof(expected)) != 0) {
+        munmap(address, size);
+        return Err("cache index has an unknown layout", 0);
+    }
+    // the mapping keeps the open file alive, closing the descriptor would not release the lock
+    flock(file.get(), LOCK_UN);
+    mapping = address;
+    mapping_size = size;
+    counters = reinterpret_cast<Counters *>(static_cast<char *>(address) + counters_offset);
+    slots = reinterpret_cast<Slot *>(static_cast<char *>(address) + header_size);
+    return {};
+}
+
+auto CacheIndex::is_open() const -> bool
+{
+    return slots != nullptr;
+}
+
+void CacheIndex::probe(std::uint64_t digest, CacheFormat format, const std::function<bool(Slot &)> &visit)
+{
+    const auto start = stored_digest(digest) + std::to_underlying(format);
+    for (std::size_t i = 0; i < max_probes; ++i) {
+        if (visit(slots[(start + i) & (slot_count - 1)])) {
+            return;
+        }
+    }
+}
+
+auto CacheIndex::find(std::uint64_t digest, CacheFormat format) -> std::optional<CacheIndexEntry>
+{
+    std::optional<CacheIndexEntry> result;
+    if (!is_open()) {
+        return result;
+    }
+    const auto wanted = stored_digest(digest);
+    probe(digest, format, [&result, wanted, format](Slot &slot) {
+        std::uint64_t seq = 0;
+        std::uint64_t key = 0;
+        auto entry = slot.read(seq, key);
+        if (!entry || key != wanted || entry->format != format) {
+            return false;
+        }
+        // advisory, a racing writer may overwrite it
+        entry->last_access = now();
+        store(slot.last_access, entry->last_access);
+        result = entry;
+        return true;
+    });
+    add(result ? counters->hits : counters->misses, 1);
+    return result;
+}
+
+void CacheIndex::insert(std::uint64_t digest, CacheIndexEntry entry)
+{
+    if (!is_open()) {
+        return;
+    }
+    entry.last_access = now();
+    const auto wanted = stored_digest(digest);
+    Slot *target = nullptr;
+    std::uint64_t target_seq = 0;
+    auto oldest = std::numeric_limits<std::int64_t>::max();
+    probe(digest, entry.format, [&](Slot &slot) {
+        std::uint64_t seq = 0;
+        std::uint64_t current_digest = 0;
+        auto current = slot.read(seq, current_digest);
+        if (!current) {
+            return false;
+        }
+        const bool same_key = current_digest == wanted && current->format == entry.format;
+        // a free slot or the key itself ends the search, otherwise the least recently used one is replaced
+        if (same_key || current_digest == 0 || current->last_access < oldest) {
+            target = &slot;
+            target_seq = seq;
+            oldest = current->last_access;
+        }
+        return same_key || current_digest == 0;
+    });
+    if (target != nullptr) {
+        target->write(target_seq, wanted, entry);
+    }
+}
+
+void CacheIndex::erase(std::uint64_t digest, CacheFormat format)
+{
+    if (!is_open()) {
+        return;
+    }
+    const auto wanted = stored_digest(digest);
+    probe(digest, format, [wanted, format](Slot &slot) {
+        std::uint64_t seq = 0;
+        std::uint64_t key = 0;
+        auto entry = slot.read(seq, key);
+        if (!entry || key != wanted || entry->format != format) {
+            return false;
+        }
+        slot.write(seq, 0, {});
+        return true;
+    });
+}
+
+void CacheIndex::clear()
+{
+    if (!is_open()) {
+        return;
+    }
+    for (std::size_t i = 0; i < slot_count; ++i) {
+        std::uint64_t seq = 0;
+        std::uint64_t key = 0;
+        if (slots[i].read(seq, key) && key != 0) {
+            slots[i].write(seq, 0, {});
+        }
+    }
+    store(counters->hits, std::uint64_t{0});
+    store(counters->misses, std::uint64_t{0});
+    store(counters->evictions, std::uint64_t{0});
+}
+
+auto CacheIndex::snapshot() const -> std::vector<CacheIndexRecord>
+{
+    std::vector<CacheIndexRecord> records;
+    if (!is_open()) {
+        return records;
+    }
+    for (std::size_t i = 0; i < slot_count; ++i) {
+        std::uint64_t seq = 0;
+        std::uint64_t key = 0;
+        if (auto entry = slots[i].read(seq, key); entry && key != 0) {
+            records.push_back({.digest = key, .entry = *entry});
+        }
+    }
+    return records;
+}
+
+auto CacheIndex::stats() const -> CacheIndexStats
+{
+    if (!is_open()) {
+        return {};
+    }
+    return {
+        .hits = load(counters->hits),
+        .misses = load(counters->misses),
+        .evictions = load(counters->evictions),
+    };
+}
+
+void CacheIndex::count_evictions(std::uint64_t count)
+{
+    if (is_open()) {
+        add(counters->evictions, count);
+    }
+}
+
+} // namespace upp
@@ -0,0 +1,215 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "image/cache_maintenance.hpp"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <charconv>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace upp
+{
+
+namespace
+{
+
+struct EntryName {
+    std::uint64_t digest = 0;
+    CacheFormat format = CacheFormat::image;
+};
+
+// entries are named by the hex digest of their key followed by the extension of their format,
+// anything else is left over from older versions or an interrupted write
+auto parse_name(std::string_view name) -> std::optional<EntryName>
+{
+    constexpr std::size_t digits = 16;
+    constexpr int base = 16;
+    if (name.size() <= digits || name[digits] != '.') {
+        return {};
+    }
+    EntryName parsed;
+    const auto *last = name.data() + digits;
+    const auto [end, error] = std::from_chars(name.data(), last, parsed.digest, base);
+    if (error != std::errc{} || end != last) {
+        return {};
+    }
+    const auto extension = name.substr(digits);
+    if (extension == ".raw") {
+        parsed.format = CacheFormat::raw;
+    } else if (extension == ".qoi") {
+        parsed.format = CacheFormat::qoi;
+    }
+    return parsed;
+}
+
+auto now() -> std::int64_t
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+auto total(const auto &files) -> CacheUsage
+{
+    CacheUsage usage{.entries = files.size()};
+    for (const auto &file : files) {
+        usage.bytes += file.size;
+    }
+    return usage;
+}
+
+} // namespace
+
+CacheMaintenance::CacheMaintenance(std::filesystem::path directory, CacheIndex *index) :
+    directory(std::move(directory)),
+    index(index)
+{
+}
+
+auto CacheMaintenance::list_files() const -> Result<std::vector<CacheFile>>
+{
+    std::map<std::pair<std::uint64_t, CacheFormat>, std::int64_t> accessed;
+    for (const auto &record : index->snapshot()) {
+        accessed.emplace(std::pair{record.digest, record.entry.format}, record.entry.last_access);
+    }
+
+    std::vector<CacheFile> files;
+    std::error_code error;
+    std::filesystem::directory_iterator entries{directory, error};
+    if (error == std::errc::no_such_file_or_directory) {
+        return files;
+    }
+    for (; !error && entries != std::filesystem::directory_iterator{}; entries.increment(error)) {
+        const auto &path = entries->path();
+        const auto name = path.filename().string();
+        struct stat info {};
+        if (name == CacheIndex::file_name || lstat(path.c_str(), &info) == -1 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        CacheFile file{
+            .path = path,
+            .size = static_cast<std::uint64_t>(info.st_size),
+            .last_access = info.st_mtim.tv_sec,
+        };
+        if (const auto parsed = parse_name(name)) {
+            file.digest = parsed->digest;
+            file.format = parsed->format;
+            if (auto found = accessed.find({parsed->digest, parsed->format}); found != accessed.end()) {
+                file.listed = true;
+                file.last_access = found->second;
+            }
+        }
+        files.push_back(std::move(file));
+    }
+    if (error) {
+        return Err("could not read the cache directory", error.value());
+    }
+    return files;
+}
+
+auto CacheMaintenance::remove(const std::vector<CacheFile> &files) const -> CacheUsage
+{
+    CacheUsage removed;
+    std::uint64_t evicted = 0;
+    for (const auto &file : files) {
+        std::error_code error;
+        // another daemon may have removed it first
+        if (!std::filesystem::remove(file.path, error)) {
+            continue;
+        }
+        removed.entries += 1;
+        removed.bytes += file.size;
+        if (file.listed) {
+            index->erase(file.digest, file.format);
+            evicted += 1;
+        }
+    }
+    index->count_evictions(evicted);
+    return removed;
+}
+
+auto CacheMaintenance::usage() const -> Result<CacheUsage>
+{
+    return list_files().transform([](const std::vector<CacheFile> &files) { return total(files); });
+}
+
+auto CacheMaintenance::prune(const CacheBudget &budget) const -> Result<CacheUsage>
+{
+    return list_files().transform([this, &budget](std::vector<CacheFile> files) {
+        const bool indexed = index->is_open();
+        const auto orphan_cutoff = now() - orphan_grace.count();
+        std::ranges::sort(files, {}, &CacheFile::last_access);
+        auto usage = total(files);
+        std::vector<CacheFile> doomed;
+        for (auto &file : files) {
+            const bool orphan = indexed && !file.listed && file.last_access < orphan_cutoff;
+            const bool over_budget = (budget.bytes != 0 && usage.bytes > budget.bytes) ||
+                                     (budget.entries != 0 && usage.entries > budget.entries);
+            if (!orphan && !over_budget) {
+                continue;
+            }
+            usage.entries -= 1;
+            usage.bytes -= file.size;
+            doomed.push_back(std::move(file));
+        }
+        return remove(doomed);
+    });
+}
+
+auto CacheMaintenance::clear() const -> Result<CacheUsage>
+{
+    return list_files().transform([this](const std::vector<CacheFile> &files) {
+        auto removed = remove(files);
+        index->clear();
+        return removed;
+    });
+}
+
+CacheEvictor::CacheEvictor(CacheMaintenance maintenance, CacheBudget budget) :
+    maintenance(std::move(maintenance)),
+    budget(budget),
+    thread([this](auto token) { run(token); })
+{
+}
+
+void CacheEvictor::run(SToken token)
+{
+    auto wake = [this] {
+        const std::scoped_lock lock{mutex};
+        wakeup.notify_all();
+    };
+    const stop_callback<decltype(wake)> stop_wakeup{token, wake};
+    std::unique_lock lock{mutex};
+    while (!token.stop_requested()) {
+        lock.unlock();
+        if (auto removed = maintenance.prune(budget); !removed) {
+            LOG_WARN("could not prune the disk cache: {}", removed.error().message());
+        } else if (removed->entries > 0) {
+            LOG_INFO("pruned {} disk cache entries, {} bytes", removed->entries, removed->bytes);
+        }
+        lock.lock();
+        wakeup.wait_for(lock, interval, [&token] { return token.stop_requested(); });
+    }
+}
+
+} // namespace upp
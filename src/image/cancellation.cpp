@@ -0,0 +1,62 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "image/cancellation.hpp"
+
+namespace upp
+{
+
+auto DecodeCancellation::track(PreviewId preview_id) -> Flag
+{
+    auto flag = std::make_shared<std::atomic_bool>(false);
+    std::scoped_lock lock{mutex};
+    in_flight.insert_or_assign(preview_id, flag);
+    return flag;
+}
+
+void DecodeCancellation::untrack(PreviewId preview_id, const Flag &flag)
+{
+    std::scoped_lock lock{mutex};
+    // a newer decode for the same preview may have replaced this one
+    if (auto found = in_flight.find(preview_id); found != in_flight.end() && found->second == flag) {
+        in_flight.erase(found);
+    }
+}
+
+auto DecodeCancellation::cancel(PreviewId preview_id) -> bool
+{
+    std::scoped_lock lock{mutex};
+    auto found = in_flight.find(preview_id);
+    if (found == in_flight.end()) {
+        return false;
+    }
+    found->second->store(true, std::memory_order_relaxed);
+    in_flight.erase(found);
+    return true;
+}
+
+void DecodeCancellation::cancel_all()
+{
+    std::scoped_lock lock{mutex};
+    for (const auto &[preview_id, flag] : in_flight) {
+        flag->store(true, std::memory_order_relaxed);
+    }
+    in_flight.clear();
+}
+
+} // namespace upp
@@ -0,0 +1,144 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "image/decode_pool.hpp"
+#include "command/response.hpp"
+#include "image/pixel_cache.hpp"
+#include "image/vips.hpp"
+#include "util/util.hpp"
+
+#include <atomic>
+#include <memory>
+#include <system_error>
+#include <utility>
+
+namespace upp
+{
+
+DecodePool::DecodePool(ApplicationContext *ctx, std::function<void()> on_decoded) :
+    ctx(ctx),
+    on_decoded(std::move(on_decoded)),
+    disk_cache(util::get_cache_path(), &ctx->cache_index),
+    // every slot goes to the workers, the submitting thread never joins in
+    arena(tbb::task_arena::automatic, 0),
+    background(tbb::task_arena::automatic, 0, tbb::task_arena::priority::low)
+{
+}
+
+DecodePool::~DecodePool()
+{
+    wait();
+}
+
+auto DecodePool::submit(const Command &cmd) -> std::future<Decoded>
+{
+    const auto &font = ctx->terminal.font;
+    const bool is_prefetch = cmd.action == Action::prefetch;
+    ImageProps props{
+        .file_path = cmd.image_path.string(),
+        .scaler = cmd.image_scaler,
+        .width = font.width * cmd.width,
+        .height = font.height * cmd.height,
+        // only decodes for shown previews can be superseded
+        .preview_id = is_prefetch ? no_preview : cmd.preview_id,
+    };
+    // tracked before the task starts, a newer command cancels it while it waits for a worker
+    if (props.preview_id != no_preview) {
+        props.cancelled = ctx->decodes.track(props.preview_id);
+    }
+    // task_group only takes copyable functors
+    auto promise = std::make_shared<std::promise<Decoded>>();
+    auto future = promise->get_future();
+    auto &target_arena = is_prefetch ? background : arena;
+    auto &target_group = is_prefetch ? background_group : group;
+    const auto priority = is_prefetch ? PixelCache::Priority::low : PixelCache::Priority::normal;
+    target_arena.execute([this, &target_group, &props, &promise, priority] {
+        // tbb calls the functor as const, so props is copied into decode
+        target_group.run([this, props = std::move(props), promise = std::move(promise), priority] {
+            Decoded decoded;
+            decoded.image = measure(decoded.elapsed, [this, &props, priority] { return decode(props, priority); });
+            if (props.cancelled) {
+                ctx->decodes.untrack(props.preview_id, props.cancelled);
+            }
+            promise->set_value(std::move(decoded));
+            on_decoded();
+        });
+    });
+    return future;
+}
+
+auto DecodePool::decode(ImageProps props, PixelCache::Priority priority) -> Result<PixelBufferPtr>
+{
+    if (props.cancelled && props.cancelled->load(std::memory_order_relaxed)) {
+        return Err("decoding", std::errc::operation_canceled);
+    }
+    auto key = PixelKey::create(props.file_path, props.width, props.height, props.scaler, ctx->pixel_format);
+    if (key) {
+        if (auto buffer = ctx->pixel_cache.find(*key)) {
+            LOG_DEBUG("using cached pixels for {}", util::get_filename(props.file_path));
+            return buffer;
+        }
+        if (auto buffer = load_from_disk(*key)) {
+            LOG_DEBUG("loaded cached pixels for {} from disk", util::get_filename(props.file_path));
+            ctx->pixel_cache.insert(*key, *buffer, priority);
+            return buffer;
+        }
+        props.key = *key;
+    }
+    LibvipsImage image{ctx};
+    return image.load(std::move(props)).transform([this, &image, &key, priority] {
+        auto buffer = image.release_buffer();
+        if (key) {
+            ctx->pixel_cache.insert(*key, buffer, priority);
+            store_on_disk(*key, *buffer);
+        }
+        return buffer;
+    });
+}
+
+auto DecodePool::load_from_disk(const PixelKey &key) -> Result<PixelBufferPtr>
+{
+    // the image format is handled by LibvipsImage, it caches before the conversion
+    if (ctx->cache_format == CacheFormat::image || !reads_disk(ctx->cache_policy)) {
+        return Err("pixel disk cache disabled", 0);
+    }
+    return disk_cache.load(key, ctx->cache_format, ctx->share_pixels);
+}
+
+void DecodePool::store_on_disk(const PixelKey &key, const PixelBuffer &buffer)
+{
+    if (ctx->cache_format == CacheFormat::image || !writes_disk(ctx->cache_policy)) {
+        return;
+    }
+    if (auto result = disk_cache.store(key, buffer, ctx->cache_format); !result) {
+        LOG_DEBUG("could not write disk cache entry: {}", result.error().message());
+    }
+}
+
+void DecodePool::wait()
+{
+    arena.execute([this] { group.wait(); });
+    background.execute([this] { background_group.wait(); });
+}
+
+auto DecodePool::concurrency() -> int
+{
+    return arena.max_concurrency();
+}
+
+} // namespace upp
@@ -0,0 +1,278 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "image/disk_cache.hpp"
+#include "image/qoi.hpp"
+#include "unix/fd.hpp"
+#include "util/crypto.hpp"
+#include "util/hash.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace upp
+{
+
+namespace
+{
+
+// the last byte versions the payload, entries written by other versions are stale
+constexpr std::array<char, 8> magic = {'U', 'P', 'P', 'P', 'I', 'X', '\0', '\2'};
+// the payload starts at a fixed offset so the header can grow without moving it
+constexpr std::size_t payload_offset = 128;
+constexpr int temp_suffix_len = 8;
+
+struct EntryHeader {
+    std::array<char, 8> magic{};
+    std::int32_t width = 0;
+    std::int32_t height = 0;
+    std::int32_t channels = 0;
+    std::uint32_t format = 0;
+    std::uint32_t encoding = 0;
+    std::uint64_t payload_size = 0;
+    // identity of the source and the decode, checked against the key on load
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::int64_t mtime_ns = 0;
+    std::uint64_t file_size = 0;
+    std::int32_t box_width = 0;
+    std::int32_t box_height = 0;
+    std::uint64_t scaler_hash = 0;
+};
+
+static_assert(sizeof(EntryHeader) <= payload_offset);
+
+auto scaler_hash(const PixelKey &key) -> std::uint64_t
+{
+    return util::hash64(std::as_bytes(std::span{key.scaler}));
+}
+
+auto make_header(const PixelKey &key, const PixelBuffer &buffer, CacheFormat encoding, std::size_t payload_size)
+    -> EntryHeader
+{
+    return {
+        .magic = magic,
+        .width = buffer.width,
+        .height = buffer.height,
+        .channels = buffer.channels,
+        .format = std::to_underlying(key.format),
+        .encoding = std::to_underlying(encoding),
+        .payload_size = payload_size,
+        .device = key.device,
+        .inode = key.inode,
+        .mtime_ns = key.mtime_ns,
+        .file_size = key.file_size,
+        .box_width = key.width,
+        .box_height = key.height,
+        .scaler_hash = scaler_hash(key),
+    };
+}
+
+auto matches(const EntryHeader &header, const PixelKey &key) -> bool
+{
+    return header.magic == magic && header.format == std::to_underlying(key.format) && header.device == key.device &&
+           header.inode == key.inode && header.mtime_ns == key.mtime_ns && header.file_size == key.file_size &&
+           header.box_width == key.width && header.box_height == key.height &&
+           header.scaler_hash == scaler_hash(key);
+}
+
+auto write_all(int filde, std::span<const char> bytes) -> Result<void>
+{
+    while (!bytes.empty()) {
+        const auto written = write(filde, bytes.data(), bytes.size());
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return Err("write");
+        }
+        bytes = bytes.subspan(static_cast<std::size_t>(written));
+    }
+    return {};
+}
+
+} // namespace
+
+DiskCache::DiskCache(std::filesystem::path directory, CacheIndex *index) :
+    directory(std::move(directory)),
+    index(index)
+{
+}
+
+auto DiskCache::format_from_string(std::string_view format) -> CacheFormat
+{
+    if (format == "raw") {
+        return CacheFormat::raw;
+    }
+    if (format == "qoi") {
+        return CacheFormat::qoi;
+    }
+    return CacheFormat::image;
+}
+
+auto DiskCache::policy_from_string(std::string_view policy) -> CachePolicy
+{
+    if (policy == "off") {
+        return CachePolicy::off;
+    }
+    if (policy == "read-only") {
+        return CachePolicy::read_only;
+    }
+    if (policy == "memory-only") {
+        return CachePolicy::memory_only;
+    }
+    return CachePolicy::read_write;
+}
+
+auto DiskCache::entry_path(const PixelKey &key, CacheFormat format) const -> std::filesystem::path
+{
+    // the digest covers the source identity, an edited source gets a new name and never sees the old entry
+    return directory / std::format("{:016x}.{}", key.digest(), format == CacheFormat::qoi ? "qoi" : "raw");
+}
+
+auto DiskCache::load(const PixelKey &key, CacheFormat format, bool share) const -> Result<PixelBufferPtr>
+{
+    const auto digest = key.digest();
+    if (index->is_open() && !index->find(digest, format)) {
+        return Err("not in the cache index", 0);
+    }
+    auto result = load_entry(key, format, share);
+    if (!result) {
+        // listed but missing or stale, don't open it again
+        index->erase(digest, format);
+    }
+    return result;
+}
+
+auto DiskCache::load_entry(const PixelKey &key, CacheFormat format, bool share) const -> Result<PixelBufferPtr>
+{
+    const unix::fd file{open(entry_path(key, format).c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!file) {
+        return Err("open");
+    }
+    struct stat info {};
+    if (fstat(file.get(), &info) == -1) {
+        return Err("fstat");
+    }
+    const auto size = static_cast<std::size_t>(info.st_size);
+    if (size < payload_offset) {
+        return Err("truncated disk cache entry", 0);
+    }
+    // the file is never written in place, a private read only mapping sees it as it was when opened
+    auto *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.get(), 0);
+    if (address == MAP_FAILED) {
+        return Err("mmap");
+    }
+    std::shared_ptr<const void> mapping{address, [size](const void *ptr) { munmap(const_cast<void *>(ptr), size); }};
+
+    EntryHeader header;
+    std::memcpy(&header, address, sizeof(header));
+    if (!matches(header, key) || header.encoding != std::to_underlying(format) ||
+        size != payload_offset + header.payload_size) {
+        return Err("stale disk cache entry", 0);
+    }
+    const auto pixels_size = static_cast<std::size_t>(header.width) * header.height * header.channels;
+    const std::span payload{static_cast<const unsigned char *>(address) + payload_offset, header.payload_size};
+
+    if (format == CacheFormat::raw) {
+        if (payload.size() != pixels_size) {
+            return Err("stale disk cache entry", 0);
+        }
+        // fd stays -1, a regular file can't be sealed so it is never handed to the display server
+        return std::make_shared<const PixelBuffer>(PixelBuffer{
+            .width = header.width,
+            .height = header.height,
+            .channels = header.channels,
+            .pixels = payload,
+            .owner = std::move(mapping),
+        });
+    }
+
+    auto encoded = qoi::read_header(payload);
+    if (!encoded || encoded->width != header.width || encoded->height != header.height ||
+        encoded->channels != header.channels) {
+        return Err("stale disk cache entry", 0);
+    }
+    auto storage = allocate_pixels(pixels_size, share);
+    return qoi::decode(payload, storage.pixels).transform([&header, &storage] {
+        return std::make_shared<const PixelBuffer>(PixelBuffer{
+            .width = header.width,
+            .height = header.height,
+            .channels = header.channels,
+            .pixels = storage.pixels,
+            .owner = std::move(storage.owner),
+            .fd = storage.fd,
+        });
+    });
+}
+
+auto DiskCache::store(const PixelKey &key, const PixelBuffer &buffer, CacheFormat format) const -> Result<void>
+{
+    std::vector<std::uint8_t> encoded;
+    std::span<const unsigned char> payload = buffer.pixels;
+    if (format == CacheFormat::qoi) {
+        encoded = qoi::encode(buffer.pixels, buffer.width, buffer.height, buffer.channels);
+        payload = encoded;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    // readers must never see a half written entry
+    const auto path = entry_path(key, format);
+    auto temp_path = path;
+    temp_path += std::format(".{}", crypto::generate_random_string(temp_suffix_len));
+
+    const unix::fd file{open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)};
+    if (!file) {
+        return Err("open");
+    }
+    std::array<char, payload_offset> prefix{};
+    const auto header = make_header(key, buffer, format, payload.size());
+    std::memcpy(prefix.data(), &header, sizeof(header));
+    const std::span bytes{reinterpret_cast<const char *>(payload.data()), payload.size()};
+    auto result = write_all(file.get(), prefix).and_then([&file, &bytes] { return write_all(file.get(), bytes); });
+    if (result) {
+        std::filesystem::rename(temp_path, path, error);
+        if (!error) {
+            index->insert(key.digest(), {
+                                            .width = buffer.width,
+                                            .height = buffer.height,
+                                            .channels = buffer.channels,
+                                            .format = format,
+                                            .size = payload_offset + payload.size(),
+                                        });
+            return {};
+        }
+        result = Err("rename", error.value());
+    }
+    std::filesystem::remove(temp_path, error);
+    return result;
+}
+
+} // namespace upp
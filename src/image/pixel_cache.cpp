@@ -0,0 +1,187 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "image/pixel_cache.hpp"
+#include "unix/shared_memory.hpp"
+#include "util/hash.hpp"
+
+#include <sys/stat.h>
+
+#include <utility>
+
+namespace upp
+{
+
+namespace
+{
+
+constexpr std::int64_t nanos_per_second = 1'000'000'000;
+
+auto buffer_bytes(const PixelBufferPtr &buffer) -> std::size_t
+{
+    return buffer->pixels.size() + sizeof(PixelBuffer);
+}
+
+// memfds kept open by the buffer
+auto open_fds(const PixelBufferPtr &buffer) -> std::size_t
+{
+    return buffer->fd != -1 ? 1 : 0;
+}
+
+} // namespace
+
+auto allocate_pixels(std::size_t size, bool share) -> PixelStorage
+{
+    if (share) {
+        if (auto memory = unix::SharedMemory::create(size)) {
+            auto shared = std::make_shared<unix::SharedMemory>(std::move(*memory));
+            const auto pixels = shared->data();
+            const int filde = shared->get_fd();
+            return {.pixels = pixels, .owner = std::move(shared), .fd = filde};
+        }
+    }
+    std::shared_ptr<unsigned char[]> buffer{new unsigned char[size]};
+    return {.pixels = {buffer.get(), size}, .owner = std::move(buffer)};
+}
+
+auto PixelKey::create(const std::string &path, int width, int height, std::string_view scaler, PixelFormat format)
+    -> Result<PixelKey>
+{
+    struct stat info {};
+    if (stat(path.c_str(), &info) == -1) {
+        return Err("could not stat image");
+    }
+    return PixelKey{
+        .device = info.st_dev,
+        .inode = info.st_ino,
+        .mtime_ns = (static_cast<std::int64_t>(info.st_mtim.tv_sec) * nanos_per_second) + info.st_mtim.tv_nsec,
+        .file_size = static_cast<std::uint64_t>(info.st_size),
+        .width = width,
+        .height = height,
+        .scaler = std::string{scaler},
+        .format = format,
+    };
+}
+
+auto PixelKey::digest() const -> std::uint64_t
+{
+    // the fixed size fields are hashed as one block, the scaler seeds it
+    struct Fields {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::int64_t mtime_ns;
+        std::uint64_t file_size;
+        std::int32_t width;
+        std::int32_t height;
+        std::uint32_t format;
+        std::uint32_t padding;
+    };
+    const Fields fields{
+        .device = device,
+        .inode = inode,
+        .mtime_ns = mtime_ns,
+        .file_size = file_size,
+        .width = width,
+        .height = height,
+        .format = std::to_underlying(format),
+        .padding = 0,
+    };
+    const auto seed = util::hash64(std::as_bytes(std::span{scaler}));
+    return util::hash64(std::as_bytes(std::span{&fields, 1}), seed);
+}
+
+auto PixelKeyHash::operator()(const PixelKey &key) const noexcept -> std::size_t
+{
+    return key.digest();
+}
+
+void PixelCache::set_budget(std::size_t new_budget)
+{
+    std::scoped_lock lock{mutex};
+    budget = new_budget;
+    evict_until(budget, max_shared_buffers);
+}
+
+auto PixelCache::find(const PixelKey &key) -> PixelBufferPtr
+{
+    std::scoped_lock lock{mutex};
+    auto found = index.find(key);
+    if (found == index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+    hits.fetch_add(1, std::memory_order_relaxed);
+    entries.splice(entries.begin(), entries, found->second);
+    return found->second->buffer;
+}
+
+void PixelCache::insert(const PixelKey &key, PixelBufferPtr buffer, Priority priority)
+{
+    const auto size = buffer_bytes(buffer);
+    std::scoped_lock lock{mutex};
+    if (size > budget) {
+        return;
+    }
+    if (auto found = index.find(key); found != index.end()) {
+        bytes -= buffer_bytes(found->second->buffer);
+        shared -= open_fds(found->second->buffer);
+        entries.erase(found->second);
+        index.erase(found);
+    }
+    const auto fds = open_fds(buffer);
+    evict_until(budget - size, max_shared_buffers - fds);
+    const auto position = priority == Priority::low ? entries.end() : entries.begin();
+    index.emplace(key, entries.insert(position, Entry{.key = key, .buffer = std::move(buffer)}));
+    bytes += size;
+    shared += fds;
+}
+
+void PixelCache::clear()
+{
+    std::scoped_lock lock{mutex};
+    index.clear();
+    entries.clear();
+    bytes = 0;
+    shared = 0;
+}
+
+auto PixelCache::stats() const -> PixelCacheStats
+{
+    std::scoped_lock lock{mutex};
+    return {
+        .hits = hits.load(std::memory_order_relaxed),
+        .misses = misses.load(std::memory_order_relaxed),
+        .evictions = evictions.load(std::memory_order_relaxed),
+        .entries = index.size(),
+        .bytes = bytes,
+    };
+}
+
+void PixelCache::evict_until(std::size_t limit, std::size_t shared_limit)
+{
+    while ((bytes > limit || shared > shared_limit) && !entries.empty()) {
+        const auto &oldest = entries.back();
+        bytes -= buffer_bytes(oldest.buffer);
+        shared -= open_fds(oldest.buffer);
+        index.erase(oldest.key);
+        entries.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace upp
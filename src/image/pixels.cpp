@@ -0,0 +1,246 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "image/pixels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UPP_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+namespace upp
+{
+
+auto output_pixel_format(std::string_view output) -> PixelFormat
+{
+    if (output == "x11" || output == "chafa") {
+        return PixelFormat::bgra;
+    }
+    if (output == "wayland") {
+        return PixelFormat::bgra_premultiplied;
+    }
+    if (output == "sixel") {
+        return PixelFormat::rgb;
+    }
+    return PixelFormat::rgba;
+}
+
+} // namespace upp
+
+namespace upp::image
+{
+
+namespace
+{
+
+constexpr std::uint8_t opaque = 0xFF;
+
+// exact x * a / 255 with rounding, the vector kernels use the same formula
+constexpr auto multiply(unsigned value, unsigned alpha) -> std::uint8_t
+{
+    const unsigned product = (value * alpha) + 128;
+    return static_cast<std::uint8_t>((product + (product >> 8U)) >> 8U);
+}
+
+// handles every layout, the vector kernels only the common ones and leave the tail of the row to this
+void convert_scalar(const std::uint8_t *src, int bands, std::uint8_t *dst, std::size_t width, PixelFormat format)
+{
+    const bool has_color = bands >= 3;
+    const bool has_alpha = bands == 2 || bands == 4;
+    const bool flatten = format == PixelFormat::rgb || format == PixelFormat::bgra_premultiplied;
+    for (std::size_t i = 0; i < width; ++i, src += bands) {
+        const std::uint8_t red = src[0];
+        const std::uint8_t green = has_color ? src[1] : red;
+        const std::uint8_t blue = has_color ? src[2] : red;
+        const std::uint8_t alpha = has_alpha ? src[bands - 1] : opaque;
+        const auto apply = [flatten, alpha](std::uint8_t value) { return flatten ? multiply(value, alpha) : value; };
+        switch (format) {
+            case PixelFormat::bgra:
+            case PixelFormat::bgra_premultiplied:
+                dst[0] = apply(blue);
+                dst[1] = apply(green);
+                dst[2] = apply(red);
+                dst[3] = alpha;
+                dst += 4;
+                break;
+            case PixelFormat::rgba:
+                dst[0] = red;
+                dst[1] = green;
+                dst[2] = blue;
+                dst[3] = alpha;
+                dst += 4;
+                break;
+            case PixelFormat::rgb:
+                dst[0] = apply(red);
+                dst[1] = apply(green);
+                dst[2] = apply(blue);
+                dst += 3;
+                break;
+        }
+    }
+}
+
+#ifdef UPP_X86_KERNELS
+
+// swaps red and blue of four rgba pixels
+auto rgba_to_bgra_mask() -> __m128i
+{
+    return _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+}
+
+// spreads four rgb pixels into bgr with a zeroed alpha byte
+auto rgb_to_bgra_mask() -> __m128i
+{
+    return _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+}
+
+auto alpha_bytes() -> __m128i
+{
+    return _mm_set1_epi32(static_cast<int>(0xFF000000U));
+}
+
+// multiplies two pixels widened to words by their alpha, the alpha word by 255
+__attribute__((target("sse4.1"))) auto scale_words_sse(__m128i words) -> __m128i
+{
+    __m128i alphas = _mm_shufflehi_epi16(_mm_shufflelo_epi16(words, 0xFF), 0xFF);
+    alphas = _mm_blend_epi16(alphas, _mm_set1_epi16(opaque), 0x88);
+    const __m128i product = _mm_add_epi16(_mm_mullo_epi16(words, alphas), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+__attribute__((target("sse4.1"))) auto premultiply_sse(__m128i bgra) -> __m128i
+{
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_packus_epi16(scale_words_sse(_mm_unpacklo_epi8(bgra, zero)),
+                            scale_words_sse(_mm_unpackhi_epi8(bgra, zero)));
+}
+
+__attribute__((target("sse4.1"))) auto convert_sse(const std::uint8_t *src, int bands, std::uint8_t *dst,
+                                                   std::size_t width, bool premultiply) -> std::size_t
+{
+    constexpr std::size_t step = 4;
+    std::size_t done = 0;
+    if (bands == 4) {
+        const __m128i mask = rgba_to_bgra_mask();
+        for (; done + step <= width; done += step) {
+            const auto *input = reinterpret_cast<const __m128i *>(src + (done * 4));
+            __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128(input), mask);
+            if (premultiply) {
+                pixels = premultiply_sse(pixels);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (done * 4)), pixels);
+        }
+    } else if (bands == 3) {
+        // the 16 byte load reads 4 bytes past the 4 pixels, stop before the end of the row
+        const __m128i mask = rgb_to_bgra_mask();
+        const __m128i alpha = alpha_bytes();
+        for (; done + step + 2 <= width; done += step) {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + (done * 3)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (done * 4)),
+                             _mm_or_si128(_mm_shuffle_epi8(pixels, mask), alpha));
+        }
+    }
+    return done;
+}
+
+__attribute__((target("avx2"))) auto scale_words_avx2(__m256i words) -> __m256i
+{
+    __m256i alphas = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(words, 0xFF), 0xFF);
+    alphas = _mm256_blend_epi16(alphas, _mm256_set1_epi16(opaque), 0x88);
+    const __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(words, alphas), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+}
+
+__attribute__((target("avx2"))) auto premultiply_avx2(__m256i bgra) -> __m256i
+{
+    // unpack and pack both work per 128 bit lane, so the pixel order is preserved
+    const __m256i zero = _mm256_setzero_si256();
+    return _mm256_packus_epi16(scale_words_avx2(_mm256_unpacklo_epi8(bgra, zero)),
+                               scale_words_avx2(_mm256_unpackhi_epi8(bgra, zero)));
+}
+
+__attribute__((target("avx2"))) auto convert_avx2(const std::uint8_t *src, int bands, std::uint8_t *dst,
+                                                  std::size_t width, bool premultiply) -> std::size_t
+{
+    constexpr std::size_t step = 8;
+    std::size_t done = 0;
+    if (bands == 4) {
+        const __m256i mask = _mm256_broadcastsi128_si256(rgba_to_bgra_mask());
+        for (; done + step <= width; done += step) {
+            const auto *input = reinterpret_cast<const __m256i *>(src + (done * 4));
+            __m256i pixels = _mm256_shuffle_epi8(_mm256_loadu_si256(input), mask);
+            if (premultiply) {
+                pixels = premultiply_avx2(pixels);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + (done * 4)), pixels);
+        }
+    } else if (bands == 3) {
+        // each lane loads 4 pixels, the upper load reads 4 bytes past the 8 pixels
+        const __m256i mask = _mm256_broadcastsi128_si256(rgb_to_bgra_mask());
+        const __m256i alpha = _mm256_broadcastsi128_si256(alpha_bytes());
+        for (; done + step + 2 <= width; done += step) {
+            const auto *first = reinterpret_cast<const __m128i *>(src + (done * 3));
+            const auto *second = reinterpret_cast<const __m128i *>(src + (done * 3) + 12);
+            const __m256i pixels = _mm256_loadu2_m128i(second, first);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + (done * 4)),
+                                _mm256_or_si256(_mm256_shuffle_epi8(pixels, mask), alpha));
+        }
+    }
+    return done;
+}
+
+using VectorKernel = std::size_t (*)(const std::uint8_t *, int, std::uint8_t *, std::size_t, bool);
+
+auto select_kernel() -> VectorKernel
+{
+    if (__builtin_cpu_supports("avx2")) {
+        return convert_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return convert_sse;
+    }
+    return nullptr;
+}
+
+#endif
+
+} // namespace
+
+void convert_row(std::span<const std::uint8_t> src, int bands, std::span<std::uint8_t> dst, PixelFormat format)
+{
+    const std::size_t width = src.size() / bands;
+    const auto *input = src.data();
+    auto *output = dst.data();
+    if ((format == PixelFormat::rgba && bands == 4) || (format == PixelFormat::rgb && bands == 3)) {
+        std::memcpy(output, input, width * bands);
+        return;
+    }
+    std::size_t done = 0;
+#ifdef UPP_X86_KERNELS
+    static const VectorKernel kernel = select_kernel();
+    const bool is_bgra = format == PixelFormat::bgra || format == PixelFormat::bgra_premultiplied;
+    if (kernel != nullptr && is_bgra) {
+        done = kernel(input, bands, output, width, format == PixelFormat::bgra_premultiplied);
+    }
+#endif
+    convert_scalar(input + (done * bands), bands, output + (done * bytes_per_pixel(format)), width - done, format);
+}
+
+} // namespace upp::image
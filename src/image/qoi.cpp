@@ -0,0 +1,258 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "image/qoi.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace upp::qoi
+{
+
+namespace
+{
+
+constexpr std::array<std::uint8_t, 4> magic = {'q', 'o', 'i', 'f'};
+constexpr std::size_t header_size = 14;
+constexpr std::array<std::uint8_t, 8> end_marker = {0, 0, 0, 0, 0, 0, 0, 1};
+// the spec limits images to 400 million pixels
+constexpr std::size_t max_pixels = 400'000'000;
+
+constexpr std::uint8_t op_index = 0x00;
+constexpr std::uint8_t op_diff = 0x40;
+constexpr std::uint8_t op_luma = 0x80;
+constexpr std::uint8_t op_run = 0xc0;
+constexpr std::uint8_t op_rgb = 0xfe;
+constexpr std::uint8_t op_rgba = 0xff;
+constexpr std::uint8_t op_mask = 0xc0;
+constexpr int max_run = 62;
+constexpr int index_size = 64;
+
+struct Pixel {
+    std::uint8_t r = 0;
+    std::uint8_t g = 0;
+    std::uint8_t b = 0;
+    std::uint8_t a = 0xff;
+
+    auto operator==(const Pixel &other) const -> bool = default;
+};
+
+using Index = std::array<Pixel, index_size>;
+
+// the spec starts the running index zeroed, alpha included
+constexpr auto zeroed_index() -> Index
+{
+    Index index{};
+    index.fill(Pixel{.a = 0});
+    return index;
+}
+
+constexpr auto hash(Pixel pixel) -> int
+{
+    return ((pixel.r * 3) + (pixel.g * 5) + (pixel.b * 7) + (pixel.a * 11)) % index_size;
+}
+
+void put_u32(std::vector<std::uint8_t> &out, std::uint32_t value)
+{
+    out.push_back(static_cast<std::uint8_t>(value >> 24U));
+    out.push_back(static_cast<std::uint8_t>(value >> 16U));
+    out.push_back(static_cast<std::uint8_t>(value >> 8U));
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+auto get_u32(const std::uint8_t *data) -> std::uint32_t
+{
+    return (static_cast<std::uint32_t>(data[0]) << 24U) | (static_cast<std::uint32_t>(data[1]) << 16U) |
+           (static_cast<std::uint32_t>(data[2]) << 8U) | data[3];
+}
+
+auto load_pixel(const std::uint8_t *src, int channels) -> Pixel
+{
+    return {.r = src[0], .g = src[1], .b = src[2], .a = channels == 4 ? src[3] : std::uint8_t{0xff}};
+}
+
+void store_pixel(std::uint8_t *dst, Pixel pixel, int channels)
+{
+    dst[0] = pixel.r;
+    dst[1] = pixel.g;
+    dst[2] = pixel.b;
+    if (channels == 4) {
+        dst[3] = pixel.a;
+    }
+}
+
+// the difference of two channels, wrapped into [-128, 127]
+auto delta(std::uint8_t value, std::uint8_t previous) -> int
+{
+    return static_cast<std::int8_t>(static_cast<std::uint8_t>(value - previous));
+}
+
+void encode_pixel(std::vector<std::uint8_t> &out, Pixel pixel, Pixel previous)
+{
+    if (pixel.a != previous.a) {
+        out.insert(out.end(), {op_rgba, pixel.r, pixel.g, pixel.b, pixel.a});
+        return;
+    }
+    const int dr = delta(pixel.r, previous.r);
+    const int dg = delta(pixel.g, previous.g);
+    const int db = delta(pixel.b, previous.b);
+    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+        out.push_back(static_cast<std::uint8_t>(op_diff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+        return;
+    }
+    const int dr_dg = dr - dg;
+    const int db_dg = db - dg;
+    if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+        out.push_back(static_cast<std::uint8_t>(op_luma | (dg + 32)));
+        out.push_back(static_cast<std::uint8_t>(((dr_dg + 8) << 4) | (db_dg + 8)));
+        return;
+    }
+    out.insert(out.end(), {op_rgb, pixel.r, pixel.g, pixel.b});
+}
+
+} // namespace
+
+auto encode(std::span<const std::uint8_t> pixels, int width, int height, int channels) -> std::vector<std::uint8_t>
+{
+    const auto count = static_cast<std::size_t>(width) * height;
+    std::vector<std::uint8_t> out;
+    // worst case is a tag byte per pixel on top of the pixel itself
+    out.reserve(header_size + (count * (channels + 1)) + end_marker.size());
+    out.insert(out.end(), magic.begin(), magic.end());
+    put_u32(out, width);
+    put_u32(out, height);
+    out.push_back(static_cast<std::uint8_t>(channels));
+    // sRGB with linear alpha, the only colorspace we produce
+    out.push_back(0);
+
+    auto index = zeroed_index();
+    Pixel previous{};
+    int run = 0;
+    const auto *src = pixels.data();
+    for (std::size_t i = 0; i < count; ++i, src += channels) {
+        const auto pixel = load_pixel(src, channels);
+        if (pixel == previous) {
+            ++run;
+            if (run == max_run || i + 1 == count) {
+                out.push_back(static_cast<std::uint8_t>(op_run | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(static_cast<std::uint8_t>(op_run | (run - 1)));
+            run = 0;
+        }
+        const int position = hash(pixel);
+        if (index[position] == pixel) {
+            out.push_back(static_cast<std::uint8_t>(op_index | position));
+        } else {
+            index[position] = pixel;
+            encode_pixel(out, pixel, previous);
+        }
+        previous = pixel;
+    }
+    out.insert(out.end(), end_marker.begin(), end_marker.end());
+    return out;
+}
+
+auto read_header(std::span<const std::uint8_t> data) -> Result<Header>
+{
+    if (data.size() < header_size + end_marker.size() || std::memcmp(data.data(), magic.data(), magic.size()) != 0) {
+        return Err("not a qoi image", 0);
+    }
+    const Header header{
+        .width = static_cast<int>(get_u32(data.data() + 4)),
+        .height = static_cast<int>(get_u32(data.data() + 8)),
+        .channels = data[12],
+    };
+    if (header.width <= 0 || header.height <= 0 || (header.channels != 3 && header.channels != 4) ||
+        static_cast<std::size_t>(header.width) * header.height > max_pixels) {
+        return Err("invalid qoi header", 0);
+    }
+    return header;
+}
+
+auto decode(std::span<const std::uint8_t> data, std::span<std::uint8_t> pixels) -> Result<void>
+{
+    auto header = read_header(data);
+    if (!header) {
+        return std::unexpected(header.error());
+    }
+    const int channels = header->channels;
+    const auto size = static_cast<std::size_t>(header->width) * header->height * channels;
+    if (pixels.size() < size) {
+        return Err("qoi destination too small", 0);
+    }
+
+    auto index = zeroed_index();
+    Pixel pixel{};
+    const auto *src = data.data() + header_size;
+    // every op is at most 5 bytes, the end marker is never read as pixels
+    const auto *end = data.data() + data.size() - end_marker.size();
+    auto *dst = pixels.data();
+    auto *dst_end = dst + size;
+    while (dst < dst_end) {
+        if (src >= end) {
+            return Err("truncated qoi image", 0);
+        }
+        const std::uint8_t tag = *src++;
+        if (tag == op_rgb || tag == op_rgba) {
+            const std::size_t length = tag == op_rgb ? 3 : 4;
+            if (static_cast<std::size_t>(end - src) < length) {
+                return Err("truncated qoi image", 0);
+            }
+            pixel.r = src[0];
+            pixel.g = src[1];
+            pixel.b = src[2];
+            if (tag == op_rgba) {
+                pixel.a = src[3];
+            }
+            src += length;
+        } else if ((tag & op_mask) == op_index) {
+            pixel = index[tag];
+        } else if ((tag & op_mask) == op_diff) {
+            pixel.r += ((tag >> 4U) & 0x03U) - 2;
+            pixel.g += ((tag >> 2U) & 0x03U) - 2;
+            pixel.b += (tag & 0x03U) - 2;
+        } else if ((tag & op_mask) == op_luma) {
+            if (src >= end) {
+                return Err("truncated qoi image", 0);
+            }
+            const int dg = (tag & 0x3fU) - 32;
+            const std::uint8_t next = *src++;
+            pixel.r += dg - 8 + ((next >> 4U) & 0x0fU);
+            pixel.g += dg;
+            pixel.b += dg - 8 + (next & 0x0fU);
+        } else {
+            // a run repeats the previous pixel and leaves the index alone
+            const auto length = std::min<std::size_t>((tag & 0x3fU) + 1, (dst_end - dst) / channels);
+            for (std::size_t i = 0; i < length; ++i, dst += channels) {
+                store_pixel(dst, pixel, channels);
+            }
+            continue;
+        }
+        index[hash(pixel)] = pixel;
+        store_pixel(dst, pixel, channels);
+        dst += channels;
+    }
+    return {};
+}
+
+} // namespace upp::qoi
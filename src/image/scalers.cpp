@@ -41,4 +41,15 @@ auto contain_sizes(const current_sizes sizes) -> target_sizes
     });
 }
 
+auto scaled_sizes(std::string_view scaler, const current_sizes sizes) -> target_sizes
+{
+    if (scaler == "contain") {
+        return contain_sizes(sizes);
+    }
+    if (scaler == "fit_contain") {
+        return fit_contain_sizes(sizes);
+    }
+    return {.width = sizes.image_width, .height = sizes.image_height};
+}
+
 } // namespace upp::image
@@ -17,18 +17,47 @@
 // along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "image/vips.hpp"
+#include "image/pixels.hpp"
 #include "image/scalers.hpp"
+#include "unix/fd.hpp"
+#include "util/crypto.hpp"
 #include "util/result.hpp"
 #include "util/util.hpp"
 
+#include <fcntl.h>
 #include <vips/vips.h>
 
-#include <algorithm>
-#include <unordered_set>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <system_error>
+#include <utility>
 
 namespace upp
 {
 
+namespace
+{
+
+void on_eval(VipsImage *image, VipsProgress * /*progress*/, gpointer user_data)
+{
+    const auto *cancelled = static_cast<const DecodeCancellation::Flag *>(user_data);
+    if ((*cancelled)->load(std::memory_order_relaxed)) {
+        vips_image_set_kill(image, TRUE);
+    }
+}
+
+void release_flag(gpointer user_data, GClosure * /*closure*/)
+{
+    delete static_cast<DecodeCancellation::Flag *>(user_data); // NOLINT
+}
+
+constexpr int temp_suffix_len = 8;
+// colour plus alpha, anything after that is dropped before conversion
+constexpr int max_bands = 4;
+
+} // namespace
+
 LibvipsImage::LibvipsImage(ApplicationContext *ctx) :
     ctx(ctx)
 {
@@ -39,112 +68,182 @@ LibvipsImage::~LibvipsImage()
     if (image != nullptr) {
         g_object_unref(image);
     }
+    if (source != nullptr) {
+        g_object_unref(source);
+    }
 }
 
 auto LibvipsImage::load(ImageProps props) -> Result<void>
 {
     this->props = std::move(props);
-    return read_image().and_then([this]() -> Result<void> {
-        resize_image();
-        process_image();
-        return {};
-    });
+    auto result = read_image()
+                      .and_then([this] { return resize_image(); })
+                      .and_then([this] { return process_image(); });
+    if (!result && is_cancelled()) {
+        LOG_INFO("decoding of {} cancelled", util::get_filename(this->props.file_path));
+        return Err("decoding", std::errc::operation_canceled);
+    }
+    return result;
+}
+
+void LibvipsImage::watch_for_cancellation(VipsImage *target)
+{
+    if (!props.cancelled) {
+        return;
+    }
+    // eval is only emitted for images with progress reporting enabled
+    vips_image_set_progress(target, TRUE);
+    // the image may outlive this decode, so the handler keeps its own reference
+    g_signal_connect_data(target, "eval", G_CALLBACK(on_eval), new DecodeCancellation::Flag(props.cancelled), // NOLINT
+                          release_flag, static_cast<GConnectFlags>(0));
+}
+
+auto LibvipsImage::is_cancelled() const -> bool
+{
+    return props.cancelled && props.cancelled->load(std::memory_order_relaxed);
 }
 
 auto LibvipsImage::read_image() -> Result<void>
 {
-    image = vips_image_new_from_file(props.file_path.c_str(), "access", VIPS_ACCESS_SEQUENTIAL, nullptr);
+    // the only open of the file, the header probe and the decode both read from this source
+    const unix::fd file{open(props.file_path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!file) {
+        return Err("failed to open image");
+    }
+    // vips keeps its own duplicate of the descriptor
+    source = vips_source_new_from_descriptor(file.get());
+    if (source == nullptr) {
+        return Err("failed to open image", 0);
+    }
+    // reads the header only, pixels are decoded once the target size is known
+    image = vips_image_new_from_source(source, "", "access", VIPS_ACCESS_SEQUENTIAL, nullptr);
     if (image == nullptr) {
-        return Err("failed to load image");
+        return Err("failed to load image", 0);
     }
     if (origin_is_animated()) {
         LOG_INFO("image is animated");
-        VipsImage *temp =
-            vips_image_new_from_file(props.file_path.c_str(), "n", -1, "access", VIPS_ACCESS_SEQUENTIAL, nullptr);
-        int n_pages = vips_image_get_n_pages(temp);
-        int temp_height = vips_image_get_height(temp);
-        LOG_DEBUG("animated sizes: {}x{}", vips_image_get_width(temp), vips_image_get_height(temp));
-        LOG_DEBUG("number of frames: {}", n_pages);
-        LOG_DEBUG("frame height: {}  original height: {}", temp_height / n_pages, height());
-        g_object_unref(temp);
+        LOG_DEBUG("number of frames: {}", vips_image_get_n_pages(image));
     }
     return {};
 }
 
-void LibvipsImage::process_image()
+auto LibvipsImage::process_image() -> Result<void>
 {
-    vips_colourspace(image, &image_out, VIPS_INTERPRETATION_sRGB, nullptr);
+    if (is_cancelled()) {
+        return Err("decoding", std::errc::operation_canceled);
+    }
+    // the conversion kernel takes 8 bit grey or srgb, each with an optional alpha band
+    const auto interpretation = vips_image_guess_interpretation(image);
+    const bool is_grey = interpretation == VIPS_INTERPRETATION_B_W || interpretation == VIPS_INTERPRETATION_GREY16;
+    if (vips_colourspace(image, &image_out, is_grey ? VIPS_INTERPRETATION_B_W : VIPS_INTERPRETATION_sRGB, nullptr) !=
+        0) {
+        return Err("failed to convert colourspace", 0);
+    }
     g_object_unref(image);
     image = image_out;
-
-    const std::unordered_set<std::string_view> bgra_outputs = {"x11", "chafa", "wayland"};
-    std::string_view output = ctx->output;
-    if (bgra_outputs.contains(output)) {
-        // alpha channel required
-        if (vips_image_hasalpha(image) == FALSE) {
-            LOG_DEBUG("adding alpha channel to image");
-            vips_addalpha(image, &image_out, nullptr);
-            g_object_unref(image);
-            image = image_out;
+    if (vips_image_get_format(image) != VIPS_FORMAT_UCHAR) {
+        if (vips_cast_uchar(image, &image_out, nullptr) != 0) {
+            return Err("failed to convert to 8 bit", 0);
         }
-
-        LOG_DEBUG("converting image to BGRX");
-        // convert from RGB to BGR
-        int chan = num_channels();
-        std::vector<VipsImage *> bands(chan, nullptr);
-        for (int i = 0; i < chan; ++i) {
-            VipsImage *band = nullptr;
-            vips_extract_band(image, &band, i, nullptr);
-            bands[i] = band;
+        g_object_unref(image);
+        image = image_out;
+    }
+    if (num_channels() > max_bands) {
+        if (vips_extract_band(image, &image_out, 0, "n", max_bands, nullptr) != 0) {
+            return Err("failed to extract bands", 0);
         }
-        std::swap(bands[0], bands[2]);
-
-        vips_bandjoin(bands.data(), &image_out, chan, nullptr);
         g_object_unref(image);
         image = image_out;
+    }
 
-        std::ranges::for_each(bands, g_object_unref);
+    format = ctx->pixel_format;
+    const auto size = static_cast<std::size_t>(width()) * height() * image::bytes_per_pixel(format);
+    // windows keep drawing the previous buffer until this one is complete
+    // with shared memory the display server maps the pixels, windows never copy them
+    storage = allocate_pixels(size, ctx->share_pixels);
+    watch_for_cancellation(image);
+    return render_into(storage.pixels);
+}
 
-    } else if (output == "sixel") {
-        // sixel expects RGB888
-        if (vips_image_hasalpha(image) == TRUE) {
-            vips_flatten(image, &image_out, nullptr);
-            g_object_unref(image);
-            image = image_out;
+auto LibvipsImage::render_into(std::span<unsigned char> destination) -> Result<void>
+{
+    struct Target {
+        std::span<unsigned char> pixels;
+        std::size_t row_bytes;
+        int pixel_bytes;
+        PixelFormat format;
+    };
+    Target target{
+        .pixels = destination,
+        .row_bytes = static_cast<std::size_t>(width()) * image::bytes_per_pixel(format),
+        .pixel_bytes = image::bytes_per_pixel(format),
+        .format = format,
+    };
+    // vips renders strips of rows in order, each one is converted straight into the destination
+    const auto write_strip = [](VipsRegion *region, VipsRect *area, void *user_data) -> int {
+        const auto *target = static_cast<const Target *>(user_data);
+        const auto bands = region->im->Bands;
+        const auto src_bytes = static_cast<std::size_t>(area->width) * bands;
+        for (int row = area->top; row < VIPS_RECT_BOTTOM(area); ++row) {
+            const auto *src = VIPS_REGION_ADDR(region, area->left, row);
+            auto dst = target->pixels.subspan((row * target->row_bytes) + (area->left * target->pixel_bytes),
+                                              static_cast<std::size_t>(area->width) * target->pixel_bytes);
+            image::convert_row({src, src_bytes}, bands, dst, target->format);
         }
+        return 0;
+    };
+    if (vips_sink_disc(image, write_strip, &target) != 0) {
+        return Err("failed to process image", 0);
     }
+    return {};
+}
 
-    image_buffer.reset(static_cast<unsigned char *>(vips_image_write_to_memory(image, nullptr)));
+auto LibvipsImage::cache_file_path() const -> std::string
+{
+    return util::get_cache_file_save_location(props.key->digest(),
+                                              std::filesystem::path{props.file_path}.extension().string());
 }
 
-auto LibvipsImage::image_is_cached(int new_width, int new_height) -> bool
+auto LibvipsImage::image_is_cached() -> bool
 {
-    auto cached_image_path = util::get_cache_file_save_location(props.file_path);
+    // the name changes with the source, the target size and the scaler, an existing entry is never stale
+    if (!props.key) {
+        return false;
+    }
+    const auto digest = props.key->digest();
+    if (ctx->cache_index.is_open() && !ctx->cache_index.find(digest, CacheFormat::image)) {
+        return false;
+    }
+    const auto cached_image_path = cache_file_path();
     VipsImage *cached_image =
         vips_image_new_from_file(cached_image_path.c_str(), "access", VIPS_ACCESS_SEQUENTIAL, nullptr);
     if (cached_image == nullptr) {
+        ctx->cache_index.erase(digest, CacheFormat::image);
         return false;
     }
-
-    int cached_width = vips_image_get_width(cached_image);
-    int cached_height = vips_image_get_height(cached_image);
-    constexpr int delta = 10;
-    if ((new_width >= cached_width && new_height >= cached_height) &&
-        ((new_width - cached_width) <= delta || (new_height - cached_height) <= delta)) {
-        g_object_unref(image);
-        image = cached_image;
-        LOG_INFO("loading image {} from cache", util::get_filename(props.file_path));
-        return true;
-    }
-
-    return false;
+    g_object_unref(image);
+    image = cached_image;
+    LOG_INFO("loading image {} from cache", util::get_filename(props.file_path));
+    return true;
 }
 
-void LibvipsImage::resize_image()
+auto LibvipsImage::resize_image() -> Result<void>
 {
-    if (props.scaler == "contain") {
-        contain_scaler();
+    const image::current_sizes sizes{
+        .width = props.width,
+        .height = props.height,
+        .image_width = width(),
+        .image_height = height(),
+    };
+    auto [new_width, new_height] = image::scaled_sizes(props.scaler, sizes);
+    if (new_width == width() && new_height == height()) {
+        // decoded at full size from the probed image
+        return {};
     }
+    if (ctx->cache_format == CacheFormat::image && reads_disk(ctx->cache_policy) && image_is_cached()) {
+        return {};
+    }
+    return shrink_on_load(new_width, new_height);
 }
 
 auto LibvipsImage::num_channels() -> int
@@ -152,44 +251,89 @@ auto LibvipsImage::num_channels() -> int
     return vips_image_get_bands(image);
 }
 
-void LibvipsImage::contain_scaler()
+auto LibvipsImage::shrink_on_load(int new_width, int new_height) -> Result<void>
 {
-    auto [new_width, new_height] = image::contain_sizes({
-        .width = props.width,
-        .height = props.height,
-        .image_width = width(),
-        .image_height = height(),
-    });
+    LOG_INFO("resizing image {} to {}x{}", util::get_filename(props.file_path), new_width, new_height);
 
-    if (new_width == width() && new_height == height()) {
-        return;
+    g_object_unref(image);
+    image = nullptr;
+    // loaders that support it (jpeg, webp, heif, svg, pdf) decode straight at a reduced size, the rest are
+    // shrunk block by block, a large source is never held at full resolution
+    if (vips_thumbnail_source(source, &image, new_width, "height", new_height, nullptr) != 0) {
+        return Err("failed to resize image", 0);
     }
-    if (image_is_cached(new_width, new_height)) {
-        return;
+    if (ctx->cache_format != CacheFormat::image || !writes_disk(ctx->cache_policy)) {
+        // no cache file to write, the thumbnail is only read by render_into
+        return {};
     }
 
-    LOG_INFO("resizing image {} to {}x{} and caching", util::get_filename(props.file_path), new_width, new_height);
-
-    g_object_unref(image);
-    vips_thumbnail(props.file_path.c_str(), &image, new_width, "height", new_height, nullptr);
-
-    // images from vips_thumbnail can only be read once
+    // images from vips_thumbnail can only be read once, the cache file and the window both need the pixels
+    watch_for_cancellation(image);
     image_out = vips_image_copy_memory(image);
     g_object_unref(image);
     image = image_out;
+    if (image == nullptr) {
+        return Err("failed to resize image", 0);
+    }
 
-    auto cached_image_path = util::get_cache_file_save_location(props.file_path);
-    vips_image_write_to_file(image, cached_image_path.c_str(), nullptr);
+    // a cancelled decode never reaches this point, so no partial cache files
+    save_to_cache();
+    return {};
+}
+
+void LibvipsImage::save_to_cache()
+{
+    if (!props.key) {
+        return;
+    }
+    // the same file may be decoded for several previews at once, readers must
+    // never see a half written file
+    const std::filesystem::path cached_image_path = cache_file_path();
+    auto temp_path = cached_image_path;
+    temp_path.replace_filename(std::format("{}.{}{}", cached_image_path.stem().string(),
+                                           crypto::generate_random_string(temp_suffix_len),
+                                           cached_image_path.extension().string()));
+    if (vips_image_write_to_file(image, temp_path.c_str(), nullptr) != 0) {
+        LOG_DEBUG("could not cache {}", util::get_filename(props.file_path));
+        return;
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, cached_image_path, error);
+    if (error) {
+        std::filesystem::remove(temp_path, error);
+        return;
+    }
+    const auto size = std::filesystem::file_size(cached_image_path, error);
+    ctx->cache_index.insert(props.key->digest(), {
+                                                     .width = width(),
+                                                     .height = height(),
+                                                     .channels = num_channels(),
+                                                     .format = CacheFormat::image,
+                                                     .size = error ? 0 : size,
+                                                 });
+}
+
+auto LibvipsImage::release_buffer() -> PixelBufferPtr
+{
+    auto released = std::exchange(storage, {});
+    return std::make_shared<const PixelBuffer>(PixelBuffer{
+        .width = width(),
+        .height = height(),
+        .channels = image::bytes_per_pixel(format),
+        .pixels = released.pixels,
+        .owner = std::move(released.owner),
+        .fd = released.fd,
+    });
 }
 
 auto LibvipsImage::data() -> unsigned char *
 {
-    return image_buffer.get();
+    return storage.pixels.data();
 }
 
 auto LibvipsImage::data_size() -> int
 {
-    return VIPS_IMAGE_SIZEOF_IMAGE(image);
+    return static_cast<int>(storage.pixels.size());
 }
 
 auto LibvipsImage::width() -> int
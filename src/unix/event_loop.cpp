@@ -0,0 +1,133 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "unix/event_loop.hpp"
+
+#include <csignal>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <span>
+#include <utility>
+
+namespace upp::unix
+{
+
+auto EventLoop::init() -> Result<void>
+{
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!epollfd) {
+        return Err("could not create epoll instance");
+    }
+    wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!wakefd) {
+        return Err("could not create eventfd");
+    }
+    return add(wakefd.get(), [this](std::uint32_t) { drain_wakeups(); });
+}
+
+auto EventLoop::add(int filde, EventCallback callback) -> Result<void>
+{
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = filde;
+    if (epoll_ctl(epollfd.get(), EPOLL_CTL_ADD, filde, &event) == -1) {
+        return Err("could not add fd to epoll");
+    }
+    callbacks.insert_or_assign(filde, std::make_shared<EventCallback>(std::move(callback)));
+    return {};
+}
+
+void EventLoop::remove(int filde)
+{
+    epoll_ctl(epollfd.get(), EPOLL_CTL_DEL, filde, nullptr);
+    callbacks.erase(filde);
+}
+
+auto EventLoop::add_signals(std::initializer_list<int> signals, SignalCallback callback) -> Result<void>
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (const int signal : signals) {
+        sigaddset(&mask, signal);
+    }
+    if (pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0) {
+        return Err("could not block signals");
+    }
+    signalfd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (!signalfd) {
+        return Err("could not create signalfd");
+    }
+    return add(signalfd.get(), [this, callback = std::move(callback)](std::uint32_t) {
+        signalfd_siginfo info{};
+        while (read(signalfd.get(), &info, sizeof(info)) == sizeof(info)) {
+            callback(static_cast<int>(info.ssi_signo));
+        }
+    });
+}
+
+auto EventLoop::run() -> Result<void>
+{
+    std::array<epoll_event, max_events> events{};
+    while (!stopped.load(std::memory_order_acquire)) {
+        const int nfds = epoll_wait(epollfd.get(), events.data(), max_events, -1);
+        if (nfds == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return Err("could not wait for events");
+        }
+        for (const auto &event : std::span{events.data(), static_cast<std::size_t>(nfds)}) {
+            // an earlier callback may have removed this fd
+            auto found = callbacks.find(event.data.fd);
+            if (found == callbacks.end()) {
+                continue;
+            }
+            auto callback = found->second;
+            (*callback)(event.events);
+        }
+    }
+    return {};
+}
+
+void EventLoop::stop()
+{
+    stopped.store(true, std::memory_order_release);
+    if (wakefd) {
+        constexpr std::uint64_t wakeup = 1;
+        [[maybe_unused]] auto written = write(wakefd.get(), &wakeup, sizeof(wakeup));
+    }
+}
+
+auto EventLoop::is_stopped() const -> bool
+{
+    return stopped.load(std::memory_order_acquire);
+}
+
+void EventLoop::drain_wakeups() const
+{
+    std::uint64_t count = 0;
+    [[maybe_unused]] auto result = read(wakefd.get(), &count, sizeof(count));
+}
+
+} // namespace upp::unix
@@ -0,0 +1,88 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "unix/shared_memory.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace upp::unix
+{
+
+auto SharedMemory::create(std::size_t size) -> Result<SharedMemory>
+{
+    SharedMemory memory;
+    memory.memfd = memfd_create("ueberzugpp-pixels", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (!memory.memfd) {
+        return Err("memfd_create");
+    }
+    // mmap rejects empty mappings
+    const auto mapped_size = std::max<std::size_t>(size, 1);
+    if (ftruncate(memory.memfd.get(), static_cast<off_t>(mapped_size)) == -1) {
+        return Err("ftruncate");
+    }
+    if (fcntl(memory.memfd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+        return Err("fcntl");
+    }
+    auto *address = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, memory.memfd.get(), 0);
+    if (address == MAP_FAILED) {
+        return Err("mmap");
+    }
+    memory.address = static_cast<unsigned char *>(address);
+    memory.size = size;
+    return memory;
+}
+
+SharedMemory::~SharedMemory()
+{
+    if (address != nullptr) {
+        munmap(address, std::max<std::size_t>(size, 1));
+    }
+}
+
+SharedMemory::SharedMemory(SharedMemory &&other) noexcept :
+    memfd(std::move(other.memfd)),
+    address(std::exchange(other.address, nullptr)),
+    size(std::exchange(other.size, 0))
+{
+}
+
+auto SharedMemory::operator=(SharedMemory &&other) noexcept -> SharedMemory &
+{
+    SharedMemory temp(std::move(other));
+    std::swap(memfd, temp.memfd);
+    std::swap(address, temp.address);
+    std::swap(size, temp.size);
+    return *this;
+}
+
+auto SharedMemory::data() const -> std::span<unsigned char>
+{
+    return {address, size};
+}
+
+auto SharedMemory::get_fd() const -> int
+{
+    return memfd.get();
+}
+
+} // namespace upp::unix
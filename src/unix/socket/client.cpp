@@ -16,7 +16,7 @@
 // You should have received a copy of the GNU General Public License
 // along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
 
-#include "unix/socket.hpp"
+#include "unix/socket/client.hpp"
 #include "util/result.hpp"
 
 #include <sys/socket.h>
@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include <array>
+#include <cerrno>
 #include <cstddef>
 #include <format>
 #include <span>
@@ -75,6 +76,19 @@ auto Client::read(std::span<std::byte> buffer) const -> Result<void>
     return {};
 }
 
+auto Client::read_some(std::span<std::byte> buffer) const -> Result<std::size_t>
+{
+    while (true) {
+        const auto status = recv(sockfd.get(), buffer.data(), buffer.size(), 0);
+        if (status >= 0) {
+            return static_cast<std::size_t>(status);
+        }
+        if (errno != EINTR) {
+            return Err("could not read from socket");
+        }
+    }
+}
+
 auto Client::read_until_empty() const -> Result<std::string>
 {
     auto result = make_result<std::string>();
@@ -20,11 +20,18 @@
 #include "util/util.hpp"
 
 #include <fcntl.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <cerrno>
 #include <filesystem>
+#include <format>
+#include <span>
 
 namespace fs = std::filesystem;
 
@@ -36,17 +43,20 @@ Server::~Server()
     fs::remove(endpoint);
 }
 
-auto Server::start() -> Result<void>
+auto Server::start(Framing new_framing) -> Result<void>
 {
+    logger = spdlog::get("socket");
+    framing = new_framing;
     endpoint = util::get_socket_path();
-    return create_socket().and_then([this] { return bind_to_endpoint(); }).and_then([this] {
-        return listen_for_connections();
-    });
+    return create_socket()
+        .and_then([this] { return bind_to_endpoint(); })
+        .and_then([this] { return listen_for_connections(); })
+        .and_then([this] { return create_epoll(); });
 }
 
 auto Server::get_fd() const -> int
 {
-    return sockfd.get();
+    return epollfd.get();
 }
 
 auto Server::get_endpoint() const -> std::string
@@ -54,21 +64,162 @@ auto Server::get_endpoint() const -> std::string
     return endpoint;
 }
 
-auto Server::read_data_from_connection() const -> Result<std::string>
+auto Server::read_data_from_connections(const DataCallback &on_data, const CloseCallback &on_close) -> Result<void>
+{
+    std::array<epoll_event, max_events> events{};
+    const int nfds = epoll_wait(epollfd.get(), events.data(), max_events, 0);
+    if (nfds == -1) {
+        if (errno == EINTR) {
+            return {};
+        }
+        return Err("could not wait for events on socket");
+    }
+
+    for (const auto &event : std::span{events.data(), static_cast<std::size_t>(nfds)}) {
+        if (event.data.u64 == listener_id) {
+            accept_connections();
+            continue;
+        }
+        if ((event.events & EPOLLOUT) != 0) {
+            if (auto conn = connections.find(event.data.u64);
+                conn != connections.end() && !flush_output(conn->first, conn->second)) {
+                disconnect(conn->second);
+            }
+        }
+        if ((event.events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+            read_from_connection(event.data.u64, on_data, on_close);
+        }
+    }
+    return {};
+}
+
+void Server::accept_connections()
+{
+    while (true) {
+        fd connfd{accept4(sockfd.get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)};
+        if (!connfd) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_DEBUG("could not accept connection: {}", os::strerror());
+            }
+            return;
+        }
+        const auto conn_id = ++last_id;
+        if (auto result = watch_fd(connfd.get(), conn_id); !result) {
+            LOG_DEBUG(result.error().message());
+            continue;
+        }
+        LOG_DEBUG("accepted connection {}, {} active", conn_id, connections.size() + 1);
+        connections.try_emplace(conn_id, Connection{.connfd = std::move(connfd), .buffer = RingBuffer{framing}});
+    }
+}
+
+void Server::read_from_connection(ConnectionId conn_id, const DataCallback &on_data, const CloseCallback &on_close)
+{
+    auto conn = connections.find(conn_id);
+    if (conn == connections.end()) {
+        return;
+    }
+
+    auto &buffer = conn->second.buffer;
+    auto is_open = buffer.fill_from_fd(conn->second.connfd.get());
+    buffer.for_each_message([conn_id, &on_data](std::string_view message) { on_data(conn_id, message); });
+    if (!is_open) {
+        LOG_WARN("dropping connection {}: {}", conn_id, is_open.error().message());
+    }
+    if (!is_open || !*is_open) {
+        LOG_DEBUG("closing connection {}", conn_id);
+        connections.erase(conn);
+        on_close(conn_id);
+    }
+}
+
+auto Server::send(ConnectionId conn_id, std::string_view data) -> Result<void>
+{
+    auto conn = connections.find(conn_id);
+    if (conn == connections.end()) {
+        return Err(std::format("connection {} is closed", conn_id), 0);
+    }
+    auto &connection = conn->second;
+    if (connection.output.size() + data.size() > max_pending_output) {
+        disconnect(connection);
+        return Err(std::format("connection {} doesn't read its responses, closing it", conn_id), 0);
+    }
+    connection.output.append(data);
+    if (!flush_output(conn_id, connection)) {
+        const int error = errno;
+        disconnect(connection);
+        return Err(std::format("could not send to connection {}", conn_id), error);
+    }
+    return {};
+}
+
+auto Server::flush_output(ConnectionId conn_id, Connection &conn) const -> bool
+{
+    std::size_t sent = 0;
+    while (sent < conn.output.size()) {
+        const auto bytes_sent = ::send(conn.connfd.get(), conn.output.data() + sent, conn.output.size() - sent,
+                                       MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (bytes_sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        sent += static_cast<std::size_t>(bytes_sent);
+    }
+    conn.output.erase(0, sent);
+    // a writable socket would wake the loop all the time, only ask while something is pending
+    const bool wants_output = !conn.output.empty();
+    if (wants_output != conn.watching_output) {
+        epoll_event event{};
+        event.events = EPOLLIN | (wants_output ? EPOLLOUT : 0U);
+        event.data.u64 = conn_id;
+        if (epoll_ctl(epollfd.get(), EPOLL_CTL_MOD, conn.connfd.get(), &event) == -1) {
+            return false;
+        }
+        conn.watching_output = wants_output;
+    }
+    return true;
+}
+
+void Server::disconnect(Connection &conn) const
 {
-    fd connfd{accept(sockfd.get(), nullptr, nullptr)};
-    return os::read_data_from_fd(connfd.get());
+    conn.output.clear();
+    shutdown(conn.connfd.get(), SHUT_RDWR);
 }
 
 auto Server::create_socket() -> Result<void>
 {
-    sockfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (!sockfd) {
         return Err("could not create socket");
     }
     return {};
 }
 
+auto Server::create_epoll() -> Result<void>
+{
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!epollfd) {
+        return Err("could not create epoll instance");
+    }
+    return watch_fd(sockfd.get(), listener_id);
+}
+
+auto Server::watch_fd(int filde, ConnectionId conn_id) const -> Result<void>
+{
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = conn_id;
+    if (epoll_ctl(epollfd.get(), EPOLL_CTL_ADD, filde, &event) == -1) {
+        return Err("could not watch file descriptor");
+    }
+    return {};
+}
+
 auto Server::bind_to_endpoint() const -> Result<void>
 {
     sockaddr_un addr{};
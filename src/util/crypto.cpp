@@ -17,7 +17,6 @@
 // along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "util/crypto.hpp"
-#include "util/ptr.hpp"
 #include "util/util.hpp"
 
 #include <openssl/evp.h>
@@ -46,24 +45,6 @@ auto buffer_to_hexstring(std::span<const std::byte> buffer) -> std::string
     return result;
 }
 
-auto blake2b_encode(std::span<const std::byte> buffer) -> std::string
-{
-    const auto mdctx = c_unique_ptr<EVP_MD_CTX, &EVP_MD_CTX_free>{EVP_MD_CTX_new()};
-#ifdef LIBRESSL_VERSION_NUMBER
-    const auto *evp = EVP_sha256();
-#else
-    const auto *evp = EVP_blake2b512();
-#endif
-
-    std::vector<unsigned char> digest(EVP_MAX_MD_SIZE);
-    EVP_DigestInit_ex(mdctx.get(), evp, nullptr);
-    EVP_DigestUpdate(mdctx.get(), reinterpret_cast<const unsigned char *>(buffer.data()), buffer.size());
-    unsigned int digest_len = 0;
-    EVP_DigestFinal_ex(mdctx.get(), digest.data(), &digest_len);
-
-    return buffer_to_hexstring(std::as_bytes(std::span{digest.data(), digest_len}));
-}
-
 auto base64_encode(std::span<const std::byte> buffer) -> std::string
 {
     const auto length = buffer.size();
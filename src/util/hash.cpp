@@ -0,0 +1,85 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "util/hash.hpp"
+
+#include <cstring>
+
+namespace upp::util
+{
+
+namespace
+{
+
+constexpr std::uint64_t secret0 = 0x2d358dccaa6c78a5UL;
+constexpr std::uint64_t secret1 = 0x8bb84b93962eacc9UL;
+constexpr std::uint64_t secret2 = 0x4b33a62ed433d4a3UL;
+constexpr std::size_t block = 16;
+
+__extension__ using uint128 = unsigned __int128;
+
+// folds the 128 bit product, the core mixing step of wyhash
+auto mix(std::uint64_t lhs, std::uint64_t rhs) -> std::uint64_t
+{
+    const auto product = static_cast<uint128>(lhs) * rhs;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64U);
+}
+
+auto read64(const std::byte *ptr) -> std::uint64_t
+{
+    std::uint64_t value = 0;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+auto read32(const std::byte *ptr) -> std::uint64_t
+{
+    std::uint32_t value = 0;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+auto hash64(std::span<const std::byte> data, std::uint64_t seed) -> std::uint64_t
+{
+    const auto size = data.size();
+    seed ^= mix(seed ^ secret0, secret1);
+    const auto *ptr = data.data();
+    auto remaining = size;
+    for (; remaining > block; remaining -= block, ptr += block) {
+        seed = mix(read64(ptr) ^ secret1, read64(ptr + 8) ^ seed);
+    }
+    // the last 1 to 16 bytes, reads may overlap but never leave the data
+    std::uint64_t first = 0;
+    std::uint64_t second = 0;
+    if (remaining >= 8) {
+        first = read64(ptr);
+        second = read64(ptr + remaining - 8);
+    } else if (remaining >= 4) {
+        first = read32(ptr);
+        second = read32(ptr + remaining - 4);
+    } else if (remaining > 0) {
+        first = (std::to_integer<std::uint64_t>(ptr[0]) << 16U) |
+                (std::to_integer<std::uint64_t>(ptr[remaining / 2]) << 8U) |
+                std::to_integer<std::uint64_t>(ptr[remaining - 1]);
+    }
+    return mix(secret2 ^ size, mix(first ^ secret1, second ^ seed));
+}
+
+} // namespace upp::util
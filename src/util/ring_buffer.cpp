@@ -0,0 +1,212 @@
+// Display images in the terminal
+// Copyright (C) 2024  JustKidding
+//
+// This file is part of ueberzugpp.
+//
+// ueberzugpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ueberzugpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ueberzugpp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "util/ring_buffer.hpp"
+#include "util/result.hpp"
+
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <ranges>
+#include <utility>
+
+namespace upp
+{
+
+RingBuffer::RingBuffer(Framing framing, std::size_t initial_capacity) :
+    buffer(std::bit_ceil(initial_capacity)),
+    framing(framing)
+{
+}
+
+auto RingBuffer::size() const -> std::size_t
+{
+    return tail - head;
+}
+
+auto RingBuffer::capacity() const -> std::size_t
+{
+    return buffer.size();
+}
+
+auto RingBuffer::mask() const -> std::size_t
+{
+    return capacity() - 1;
+}
+
+void RingBuffer::clear()
+{
+    head = tail = scanned = skip = 0;
+    discarding = false;
+}
+
+auto RingBuffer::fill_from_fd(int filde) -> Result<bool>
+{
+    int available = 0;
+    if (ioctl(filde, FIONREAD, &available) == -1 || available <= 0) {
+        available = 1; // let read report end of file or errors
+    }
+
+    const auto wanted = size() + static_cast<std::size_t>(available);
+    if (wanted > capacity()) {
+        grow(std::min(wanted, max_capacity));
+    }
+    if (size() == capacity()) {
+        // a single message doesn't fit, skip until its end
+        clear();
+        discarding = framing == Framing::newline;
+    }
+
+    const std::size_t free = capacity() - size();
+    const std::size_t idx = tail & mask();
+    const std::size_t first = std::min(free, capacity() - idx);
+    std::array<iovec, 2> iov{{
+        {.iov_base = &buffer[idx], .iov_len = first},
+        {.iov_base = buffer.data(), .iov_len = free - first},
+    }};
+    const int iovcnt = iov[1].iov_len == 0 ? 1 : 2;
+
+    ssize_t bytes_read = -1;
+    do {
+        bytes_read = readv(filde, iov.data(), iovcnt);
+    } while (bytes_read == -1 && errno == EINTR);
+
+    if (bytes_read == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        }
+        return Err("could not read from file descriptor");
+    }
+    tail += static_cast<std::size_t>(bytes_read);
+    return bytes_read != 0;
+}
+
+auto RingBuffer::next_message() -> std::optional<std::string_view>
+{
+    if (framing == Framing::length_prefix) {
+        return next_frame();
+    }
+    return next_line();
+}
+
+auto RingBuffer::next_line() -> std::optional<std::string_view>
+{
+    while (scanned < size()) {
+        const std::size_t pos = head + scanned;
+        const std::size_t idx = pos & mask();
+        const std::size_t segment = std::min(tail - pos, capacity() - idx);
+        const auto *found = static_cast<const char *>(std::memchr(&buffer[idx], '\n', segment));
+        if (found == nullptr) {
+            scanned += segment;
+            continue;
+        }
+
+        const std::size_t length = scanned + static_cast<std::size_t>(found - &buffer[idx]);
+        // replace the newline so the view is null terminated
+        buffer[(head + length) & mask()] = '\0';
+        const auto line = take(head, length);
+        head += length + 1;
+        scanned = 0;
+        if (discarding) {
+            discarding = false;
+            continue;
+        }
+        return line;
+    }
+    if (size() == 0) {
+        head = tail = 0;
+    }
+    return {};
+}
+
+auto RingBuffer::next_frame() -> std::optional<std::string_view>
+{
+    while (true) {
+        const std::size_t skipped = std::min(skip, size());
+        head += skipped;
+        skip -= skipped;
+        if (skip != 0 || size() < length_size) {
+            break;
+        }
+
+        std::array<unsigned char, length_size> prefix{};
+        copy_out(head, reinterpret_cast<char *>(prefix.data()), length_size);
+        std::uint32_t length = 0;
+        for (auto byte : prefix | std::views::reverse) {
+            length = (length << 8U) | byte;
+        }
+
+        if (length > max_capacity - length_size) {
+            skip = length_size + length;
+            continue;
+        }
+        if (size() < length_size + length) {
+            break;
+        }
+        const auto frame = take(head + length_size, length);
+        head += length_size + length;
+        return frame;
+    }
+    if (size() == 0) {
+        head = tail = 0;
+    }
+    return {};
+}
+
+void RingBuffer::copy_out(std::size_t pos, char *dest, std::size_t length) const
+{
+    const std::size_t start = pos & mask();
+    const std::size_t first = std::min(length, capacity() - start);
+    std::memcpy(dest, &buffer[start], first);
+    std::memcpy(dest + first, buffer.data(), length - first);
+}
+
+auto RingBuffer::take(std::size_t pos, std::size_t length) -> std::string_view
+{
+    // lines also need the byte after them to be contiguous
+    const std::size_t start = pos & mask();
+    if (start + length < capacity()) {
+        return {&buffer[start], length};
+    }
+    scratch.resize(length);
+    copy_out(pos, scratch.data(), length);
+    return scratch;
+}
+
+void RingBuffer::grow(std::size_t min_capacity)
+{
+    const std::size_t new_capacity = std::bit_ceil(min_capacity);
+    if (new_capacity <= capacity()) {
+        return;
+    }
+    std::vector<char> new_buffer(new_capacity);
+    const std::size_t length = size();
+    copy_out(head, new_buffer.data(), length);
+
+    buffer = std::move(new_buffer);
+    scanned = std::min(scanned, length);
+    head = 0;
+    tail = length;
+}
+
+} // namespace upp
@@ -18,7 +18,6 @@
 
 #include "util/util.hpp"
 #include "os/os.hpp"
-#include "util/crypto.hpp"
 
 #include <filesystem>
 #include <format>
@@ -57,10 +56,9 @@ auto get_cache_path() -> std::filesystem::path
     return cache_home / "ueberzugpp";
 }
 
-auto get_cache_file_save_location(const std::filesystem::path &path) -> std::string
+auto get_cache_file_save_location(std::uint64_t digest, std::string_view extension) -> std::string
 {
-    auto hashed_path = crypto::blake2b_encode(make_buffer(path.string())) + path.extension().string();
-    return get_cache_path() / hashed_path;
+    return get_cache_path() / std::format("{:016x}{}", digest, extension);
 }
 
 auto get_filename(std::string_view path) -> std::string
@@ -23,9 +23,17 @@
 #include "util/result.hpp"
 #include "wayland/types.hpp"
 
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <iterator>
+#include <span>
 #include <string_view>
+#include <system_error>
+#include <utility>
 
 namespace upp
 {
@@ -39,6 +47,17 @@ constexpr xdg_wm_base_listener xdg_wm_base_listener = {
     .ping = WaylandCanvas::xdg_wm_base_ping,
 };
 
+constexpr wl_shm_listener shm_listener = {
+    .format = WaylandCanvas::wl_shm_format,
+};
+
+constexpr wl_callback_listener frame_listener = {
+    .done = WaylandCanvas::wl_callback_done,
+};
+
+// surfaces the compositor doesn't show, like on another workspace, never get their frame
+constexpr auto frame_timeout = std::chrono::milliseconds(100);
+
 void WaylandCanvas::wl_registry_global(void *data, wl_registry *registry, uint32_t name, const char *interface,
                                        [[maybe_unused]] uint32_t version)
 {
@@ -54,6 +73,7 @@ void WaylandCanvas::wl_registry_global(void *data, wl_registry *registry, uint32
             static_cast<wl_compositor *>(wl_registry_bind(registry, name, &wl_compositor_interface, compositor_ver)));
     } else if (interface_str == wl_shm_interface.name) {
         canvas->shm.reset(static_cast<wl_shm *>(wl_registry_bind(registry, name, &wl_shm_interface, shm_ver)));
+        wl_shm_add_listener(canvas->shm.get(), &shm_listener, canvas);
     } else if (interface_str == xdg_wm_base_interface.name) {
         canvas->wm_base.reset(
             static_cast<xdg_wm_base *>(wl_registry_bind(registry, name, &xdg_wm_base_interface, xdg_base_ver)));
@@ -61,6 +81,22 @@ void WaylandCanvas::wl_registry_global(void *data, wl_registry *registry, uint32
     }
 }
 
+void WaylandCanvas::wl_shm_format(void *data, [[maybe_unused]] wl_shm *shm, uint32_t format)
+{
+    auto *canvas = static_cast<WaylandCanvas *>(data);
+    canvas->shm_formats.insert(format);
+}
+
+void WaylandCanvas::wl_callback_done(void *data, wl_callback *callback, [[maybe_unused]] uint32_t time)
+{
+    auto *canvas = static_cast<WaylandCanvas *>(data);
+    {
+        std::scoped_lock frame_lock{canvas->frame_mutex};
+        canvas->pending_frames.erase(callback);
+    }
+    canvas->frame_done.notify_all();
+}
+
 void WaylandCanvas::xdg_wm_base_ping([[maybe_unused]] void *data, xdg_wm_base *xdg_wm_base, uint32_t serial)
 {
     xdg_wm_base_pong(xdg_wm_base, serial);
@@ -80,50 +116,126 @@ auto WaylandCanvas::init() -> Result<void>
     registry.reset(wl_display_get_registry(display.get()));
     wl_registry_add_listener(registry.get(), &registry_listener, this);
     wl_display_roundtrip(display.get());
+    // formats are announced once wl_shm is bound
+    wl_display_roundtrip(display.get());
+    negotiate_pixel_format();
+    ctx->share_pixels = true;
 
     display_fd = wl_display_get_fd(display.get());
-    event_handler = jthread([this](auto token) { handle_events(token); });
-
     LOG_INFO("canvas created");
-    return {};
+    return ctx->loop.add(display_fd, [this](std::uint32_t events) { handle_events(events); });
+}
+
+void WaylandCanvas::negotiate_pixel_format()
+{
+    // both formats are mandatory, but a compositor that skips the alpha one still gets opaque pixels
+    if (shm_formats.contains(WL_SHM_FORMAT_ARGB8888)) {
+        ctx->pixel_format = PixelFormat::bgra_premultiplied;
+    } else {
+        LOG_WARN("compositor does not support ARGB8888, transparency is lost");
+        ctx->pixel_format = PixelFormat::bgra;
+    }
 }
 
-void WaylandCanvas::handle_events(SToken token)
+void WaylandCanvas::handle_events(std::uint32_t events)
 {
-    LOG_DEBUG("started event handler");
+    if ((events & (EPOLLERR | EPOLLHUP)) != 0) {
+        LOG_ERROR("connection to the wayland display was lost");
+        ctx->loop.remove(display_fd);
+        Application::terminate();
+        return;
+    }
     auto *display_ptr = display.get();
+    while (wl_display_prepare_read(display_ptr) != 0) {
+        wl_display_dispatch_pending(display_ptr);
+    }
+    // the fd is readable, so this does not block
+    wl_display_read_events(display_ptr);
+    wl_display_dispatch_pending(display_ptr);
+    wl_display_flush(display_ptr);
+}
 
-    while (!token.stop_requested()) {
-        while (wl_display_prepare_read(display_ptr) != 0) {
-            wl_display_dispatch_pending(display_ptr);
-        }
-        wl_display_flush(display_ptr);
-
-        if (auto in_event = os::wait_for_data_on_fd(display_fd)) {
-            if (*in_event) {
-                wl_display_read_events(display_ptr);
-                wl_display_dispatch_pending(display_ptr);
-            } else {
-                wl_display_cancel_read(display_ptr);
+auto WaylandCanvas::execute(const Command &cmd, std::span<Decoded> decoded) -> std::vector<Outcome>
+{
+    std::vector<Outcome> outcomes;
+    std::vector<wl::callback> frames;
+    if (cmd.action == Action::batch) {
+        LOG_TRACE("executing batch of {} commands", cmd.batch.size());
+        outcomes.reserve(cmd.batch.size());
+        std::ranges::transform(cmd.batch, decoded, std::back_inserter(outcomes),
+                               [this, &frames](const Command &child, Decoded &image) {
+                                   return execute_command(child, image, frames);
+                               });
+    } else {
+        outcomes.push_back(execute_command(cmd, decoded.front(), frames));
+    }
+    // send every surface update of the unit at once, responses wait until the new surfaces are on screen
+    Clock::duration present{};
+    measure(present, [this, &frames] {
+        wl_display_flush(display.get());
+        wait_for_frames(frames);
+    });
+    for (auto &outcome : outcomes) {
+        outcome.timings.present += present;
+    }
+    return outcomes;
+}
+
+auto WaylandCanvas::execute_command(const Command &cmd, Decoded &decoded, std::vector<wl::callback> &frames)
+    -> Outcome
+{
+    Outcome outcome;
+    switch (cmd.action) {
+        case Action::add: {
+            outcome.timings.decode = decoded.elapsed;
+            if (!decoded.image) {
+                if (decoded.image.error().code() != std::errc::operation_canceled) {
+                    LOG_WARN(decoded.image.error().message());
+                }
+                outcome.result = std::unexpected(decoded.image.error());
+                break;
+            }
+            auto window = std::make_shared<WaylandWindow>(ctx, compositor.get(), shm.get(), wm_base.get());
+            outcome.result = window->init(cmd, std::move(*decoded.image), window_ptrs, outcome.timings);
+            if (!outcome.result) {
+                LOG_WARN(outcome.result.error().message());
+                break;
             }
-        } else {
-            Application::terminate();
+            window_map.insert_or_assign(cmd.preview_id, window);
+            // only clients that asked for a response wait for the compositor
+            if (!cmd.request_id.empty()) {
+                std::scoped_lock frame_lock{frame_mutex};
+                pending_frames.insert(frames.emplace_back(window->frame(&frame_listener, this)).get());
+            }
+            break;
         }
+        case Action::remove:
+            window_map.erase(cmd.preview_id);
+            break;
+        default:
+            break;
     }
+    return outcome;
 }
 
-void WaylandCanvas::execute(const Command &cmd)
+void WaylandCanvas::wait_for_frames(std::vector<wl::callback> &frames)
 {
-    if (cmd.action == "add") {
-        auto window = std::make_shared<WaylandWindow>(ctx, compositor.get(), shm.get(), wm_base.get());
-        if (auto result = window->init(cmd, window_ptrs)) {
-            window_map.try_emplace(cmd.preview_id, window);
-        } else {
-            LOG_WARN(result.error().message());
-        }
-    } else if (cmd.action == "remove") {
-        window_map.erase(cmd.preview_id);
+    if (frames.empty()) {
+        return;
+    }
+    std::unique_lock frame_lock{frame_mutex};
+    const auto presented = [this, &frames] {
+        return std::ranges::none_of(frames,
+                                    [this](const wl::callback &frame) { return pending_frames.contains(frame.get()); });
+    };
+    if (!frame_done.wait_for(frame_lock, frame_timeout, presented)) {
+        LOG_DEBUG("compositor did not present {} new surfaces in time", frames.size());
+    }
+    for (const auto &frame : frames) {
+        pending_frames.erase(frame.get());
     }
+    // destroyed under the lock, a late done event then finds nothing to erase
+    frames.clear();
 }
 
 } // namespace upp
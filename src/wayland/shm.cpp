@@ -18,10 +18,8 @@
 
 #include "wayland/shm.hpp"
 
-#include <sys/mman.h>
-#include <unistd.h>
-
 #include <cstring>
+#include <utility>
 
 namespace upp
 {
@@ -35,43 +33,35 @@ void WaylandShm::wl_buffer_release([[maybe_unused]] void *data, wl_buffer *buffe
     wl_buffer_destroy(buffer);
 }
 
-WaylandShm::WaylandShm(wl::shm_ptr shm) :
-    shm(shm)
-{
-}
-
-WaylandShm::~WaylandShm()
+WaylandShm::WaylandShm(wl::shm_ptr shm, uint32_t format) :
+    shm(shm),
+    format(format)
 {
-    munmap(pool_data, pool_size);
 }
 
-auto WaylandShm::init(int new_width, int new_height, unsigned char *data) -> Result<void>
+auto WaylandShm::init(PixelBufferPtr new_image) -> Result<void>
 {
-    width = new_width;
-    height = new_height;
-    stride = width * 4;
-    const int image_size = height * stride;
-    pool_size = image_size * 2;
-    memfd = memfd_create("ueberzugpp-shm", 0);
-    if (!memfd) {
-        return Err("memfd_create");
-    }
-    if (ftruncate(memfd.get(), pool_size) == -1) {
-        return Err("ftruncate");
-    }
-    auto *pool_ptr = mmap(nullptr, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd.get(), 0);
-    if (pool_ptr == MAP_FAILED) {
-        return Err("mmap");
+    image = std::move(new_image);
+    width = image->width;
+    height = image->height;
+    stride = width * image->channels;
+    pool_size = height * stride;
+    if (image->fd != -1) {
+        copy.reset();
+        pool_fd = image->fd;
+        return {};
     }
-    pool_data = static_cast<uint8_t *>(pool_ptr);
-    std::memcpy(pool_data, data, image_size);
-    return {};
+    return unix::SharedMemory::create(pool_size).transform([this](unix::SharedMemory memory) {
+        std::memcpy(memory.data().data(), image->pixels.data(), pool_size);
+        pool_fd = memory.get_fd();
+        copy = std::move(memory);
+    });
 }
 
 auto WaylandShm::get_buffer() -> wl::buffer_ptr
 {
-    wl::shm_pool pool{wl_shm_create_pool(shm, memfd.get(), pool_size)};
-    wl::buffer_ptr buffer = wl_shm_pool_create_buffer(pool.get(), 0, width, height, stride, WL_SHM_FORMAT_ARGB8888);
+    wl::shm_pool pool{wl_shm_create_pool(shm, pool_fd, pool_size)};
+    wl::buffer_ptr buffer = wl_shm_pool_create_buffer(pool.get(), 0, width, height, stride, format);
     wl_buffer_add_listener(buffer, &buffer_listener, nullptr);
     return buffer;
 }
@@ -20,6 +20,7 @@
 #include "util/crypto.hpp"
 
 #include <format>
+#include <utility>
 
 namespace upp
 {
@@ -69,8 +70,7 @@ void WaylandWindow::preferred_buffer_scale(void *data, wl_surface *surface, int
 
 WaylandWindow::WaylandWindow(ApplicationContext *ctx, wl_compositor *compositor, wl_shm *shm, xdg_wm_base *wm_base) :
     ctx(ctx),
-    image(ctx),
-    shm(shm),
+    shm(shm, ctx->pixel_format == PixelFormat::bgra_premultiplied ? WL_SHM_FORMAT_ARGB8888 : WL_SHM_FORMAT_XRGB8888),
     surface(wl_compositor_create_surface(compositor)),
     xdg_surface(xdg_wm_base_get_xdg_surface(wm_base, surface.get())),
     xdg_toplevel(xdg_surface_get_toplevel(xdg_surface.get())),
@@ -91,21 +91,22 @@ auto WaylandWindow::socket_setup(const Command &command) -> Result<void>
     return ctx->wl_socket->setup(app_id, xcoord, ycoord);
 }
 
-auto WaylandWindow::init(const Command &command, WindowPtrs &window_ptrs) -> Result<void>
+auto WaylandWindow::init(const Command &command, PixelBufferPtr new_image, WindowPtrs &window_ptrs,
+                         Timings &timings) -> Result<void>
 {
-    auto &font = ctx->terminal.font;
-    return image
-        .load({
-            .file_path = command.image_path.string(),
-            .scaler = command.image_scaler,
-            .width = font.width * command.width,
-            .height = font.height * command.height,
-        })
-        .and_then([this] { return shm.init(image.width(), image.height(), image.data()); })
+    return measure(timings.upload, [this, &new_image] { return shm.init(std::move(new_image)); })
         .and_then([this, &command] { return socket_setup(command); })
         .and_then([this, &window_ptrs] { return listeners_setup(window_ptrs); });
 }
 
+auto WaylandWindow::frame(const wl_callback_listener *listener, void *data) -> wl::callback
+{
+    // applied by the commit that attaches the buffer once the surface is configured
+    wl::callback callback{wl_surface_frame(surface.get())};
+    wl_callback_add_listener(callback.get(), listener, data);
+    return callback;
+}
+
 auto WaylandWindow::listeners_setup(WindowPtrs &window_ptrs) -> Result<void>
 {
     auto weak_win = window_ptrs.emplace(window_ptrs.end(), weak_from_this());
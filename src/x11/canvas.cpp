@@ -20,12 +20,21 @@
 #include "application/application.hpp"
 #include "application/context.hpp"
 #include "command/command.hpp"
-#include "os/os.hpp"
 #include "terminal.hpp"
 #include "util/ptr.hpp"
 #include "util/result.hpp"
 #include "x11/window.hpp"
 
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
 namespace upp
 {
 X11Canvas::X11Canvas(ApplicationContext *ctx) :
@@ -35,23 +44,99 @@ X11Canvas::X11Canvas(ApplicationContext *ctx) :
 
 auto X11Canvas::init() -> Result<void>
 {
+    negotiate_pixel_format();
+    ctx->share_pixels = ctx->x11.has_shm_fd;
     LOG_INFO("canvas created");
-    event_handler = jthread([this](auto token) { handle_events(token); });
-    return {};
+    return ctx->loop.add(ctx->x11.connection_fd, [this](std::uint32_t events) { handle_events(events); });
 }
 
-void X11Canvas::execute(const Command &cmd)
+void X11Canvas::negotiate_pixel_format()
 {
-    std::scoped_lock window_lock{window_mutex};
-    if (cmd.action == "add") {
-        handle_add_command(cmd);
-    } else if (cmd.action == "remove") {
-        handle_remove_command(cmd);
+    const auto *screen = ctx->x11.screen;
+    const auto *setup = xcb_get_setup(ctx->x11.connection.get());
+    constexpr std::uint32_t low_byte = 0xFF;
+    constexpr std::uint32_t middle_byte = 0xFF00;
+    constexpr std::uint32_t high_byte = 0xFF0000;
+    for (auto depths = xcb_screen_allowed_depths_iterator(screen); depths.rem != 0; xcb_depth_next(&depths)) {
+        for (auto visuals = xcb_depth_visuals_iterator(depths.data); visuals.rem != 0; xcb_visualtype_next(&visuals)) {
+            const auto *visual = visuals.data;
+            if (visual->visual_id != screen->root_visual) {
+                continue;
+            }
+            // 32 bit pixels in client byte order, the masks give the order of the color bytes
+            if (setup->image_byte_order == XCB_IMAGE_ORDER_LSB_FIRST && visual->green_mask == middle_byte) {
+                if (visual->red_mask == high_byte && visual->blue_mask == low_byte) {
+                    ctx->pixel_format = PixelFormat::bgra;
+                    return;
+                }
+                if (visual->red_mask == low_byte && visual->blue_mask == high_byte) {
+                    LOG_DEBUG("root visual uses RGB byte order");
+                    ctx->pixel_format = PixelFormat::rgba;
+                    return;
+                }
+            }
+            LOG_WARN("unsupported root visual, colors may be wrong");
+            return;
+        }
     }
 }
 
-void X11Canvas::handle_add_command(const Command &cmd)
+auto X11Canvas::execute(const Command &cmd, std::span<Decoded> decoded) -> std::vector<Outcome>
 {
+    std::vector<Outcome> outcomes;
+    {
+        std::scoped_lock window_lock{window_mutex};
+        if (cmd.action == Action::batch) {
+            LOG_TRACE("executing batch of {} commands", cmd.batch.size());
+            outcomes.reserve(cmd.batch.size());
+            std::ranges::transform(
+                cmd.batch, decoded, std::back_inserter(outcomes),
+                [this](const Command &child, Decoded &image) { return execute_command(child, image); });
+        } else {
+            outcomes.push_back(execute_command(cmd, decoded.front()));
+        }
+    }
+    // a single flush per unit, intermediate states are never sent to the server.
+    // Responses wait for the round trip, the server has drawn the images once it answers
+    Clock::duration present{};
+    if (cmd.wants_response()) {
+        measure(present, [this] { ctx->x11.sync(); });
+    } else {
+        ctx->x11.flush();
+    }
+    // events read along with a reply would not wake the event loop
+    dispatch_events();
+    for (auto &outcome : outcomes) {
+        outcome.timings.present += present;
+    }
+    return outcomes;
+}
+
+auto X11Canvas::execute_command(const Command &cmd, Decoded &decoded) -> Outcome
+{
+    Outcome outcome;
+    switch (cmd.action) {
+        case Action::add:
+            outcome.timings.decode = decoded.elapsed;
+            outcome.result = handle_add_command(cmd, decoded, outcome.timings);
+            break;
+        case Action::remove:
+            handle_remove_command(cmd);
+            break;
+        default:
+            break;
+    }
+    return outcome;
+}
+
+auto X11Canvas::handle_add_command(const Command &cmd, Decoded &decoded, Timings &timings) -> Result<void>
+{
+    if (!decoded.image) {
+        if (decoded.image.error().code() != std::errc::operation_canceled) {
+            LOG_WARN(decoded.image.error().message());
+        }
+        return std::unexpected(decoded.image.error());
+    }
     std::shared_ptr<X11Window> window_ptr;
     if (auto window = window_id_map.find(cmd.preview_id); window == window_id_map.end()) {
         LOG_TRACE("creating new window");
@@ -61,11 +146,13 @@ void X11Canvas::handle_add_command(const Command &cmd)
         LOG_TRACE("reusing existing window");
         window_ptr = window->second;
     }
-    if (auto result = window_ptr->init(cmd)) {
+    auto result = window_ptr->init(cmd, std::move(*decoded.image), timings);
+    if (result) {
         window_id_map.try_emplace(cmd.preview_id, window_ptr);
     } else {
         LOG_WARN(result.error().message());
     }
+    return result;
 }
 
 void X11Canvas::handle_remove_command(const Command &cmd)
@@ -80,19 +167,15 @@ void X11Canvas::handle_remove_command(const Command &cmd)
     }
 }
 
-void X11Canvas::handle_events(SToken token)
+void X11Canvas::handle_events(std::uint32_t events)
 {
-    LOG_DEBUG("started event handler");
-    const int filde = ctx->x11.connection_fd;
-    while (!token.stop_requested()) {
-        if (auto in_event = os::wait_for_data_on_fd(filde)) {
-            if (*in_event) {
-                dispatch_events();
-            }
-        } else {
-            Application::terminate();
-        }
+    if ((events & (EPOLLERR | EPOLLHUP)) != 0) {
+        LOG_ERROR("connection to the X server was lost");
+        ctx->loop.remove(ctx->x11.connection_fd);
+        Application::terminate();
+        return;
     }
+    dispatch_events();
 }
 
 void X11Canvas::dispatch_events()
@@ -131,6 +214,7 @@ void X11Canvas::handle_expose_event(xcb_generic_event_t *event)
     }
     if (auto window = window_ptr->second.lock()) {
         window->draw(window_id);
+        ctx->x11.flush();
     }
 }
 
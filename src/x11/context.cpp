@@ -61,6 +61,7 @@ auto X11Context::init() -> Result<void>
 
     pid_window_map.reserve(num_clients);
     create_gcontext();
+    query_shm();
 
     return os::get_pid_from_socket(connection_fd).and_then([this](int pid) -> Result<void> {
         auto proc_name = os::get_pid_process_name(pid);
@@ -82,6 +83,13 @@ void X11Context::flush() const
     xcb_flush(connection.get());
 }
 
+void X11Context::sync() const
+{
+    // any request with a reply does, the server answers in order
+    const unique_C_ptr<xcb_get_input_focus_reply_t> reply{
+        xcb_get_input_focus_reply(connection.get(), xcb_get_input_focus(connection.get()), nullptr)};
+}
+
 auto X11Context::load_state(int pid) -> Result<void>
 {
     if (!is_valid) {
@@ -229,6 +237,19 @@ void X11Context::create_gcontext()
     LOG_DEBUG("created gc with id {}", gcontext);
 }
 
+void X11Context::query_shm()
+{
+    auto reply =
+        xcb::get_result(xcb_shm_query_version_reply, connection.get(), xcb_shm_query_version(connection.get()));
+    if (!reply) {
+        handle_xcb_error(reply.error().get());
+        return;
+    }
+    const auto &version = *reply;
+    has_shm_fd = version->major_version > 1 || (version->major_version == 1 && version->minor_version >= 2);
+    LOG_DEBUG("MIT-SHM {}.{}", version->major_version, version->minor_version);
+}
+
 void X11Context::handle_xcb_error(xcb::error_ptr err) const
 {
     const char *extension = nullptr;
@@ -31,7 +31,6 @@ window::window(connection_ptr connection, screen_ptr screen, window_id parent_id
 window::~window()
 {
     xcb_destroy_window(connection, _id);
-    xcb_flush(connection);
 }
 
 void window::create()
@@ -18,60 +18,114 @@
 
 #include "x11/window.hpp"
 
+#include <unistd.h>
+
+#include <cstdint>
+#include <utility>
+
 namespace upp
 {
 
 X11Window::X11Window(ApplicationContext *ctx, WindowMap *window_map) :
     ctx(ctx),
     window_map(window_map),
-    image(ctx),
     xcb_window(ctx->x11.connection.get(), ctx->x11.screen, ctx->x11.parent)
 {
 }
 
+X11Window::~X11Window()
+{
+    detach_segment();
+}
+
 void X11Window::create_xcb_windows()
 {
     xcb_window.create();
     window_map->emplace(xcb_window.id(), weak_from_this());
 }
 
-auto X11Window::init(const Command &command) -> Result<void>
+auto X11Window::init(const Command &command, PixelBufferPtr new_image, Timings &timings) -> Result<void>
 {
     std::scoped_lock image_lock{image_mutex};
-    auto &font = ctx->terminal.font;
-    return image
-        .load({
-            .file_path = command.image_path.string(),
-            .scaler = command.image_scaler,
-            .width = font.width * command.width,
-            .height = font.height * command.height,
-        })
-        .and_then([this, &command]() { return configure_xcb_windows(command); });
+    image = std::move(new_image);
+    return configure_xcb_windows(command).transform([this, &timings] {
+        // drawn right away instead of on the first exposure, so the pixels go out with their command
+        measure(timings.upload, [this] { put_image(xcb_window.id()); });
+    });
 }
 
 auto X11Window::configure_xcb_windows(const Command &command) -> Result<void>
 {
     auto &x11 = ctx->x11;
     auto &font = ctx->terminal.font;
-    xcb_image.reset(xcb_image_create_native(x11.connection.get(), image.width(), image.height(),
-                                            XCB_IMAGE_FORMAT_Z_PIXMAP, x11.screen->root_depth, nullptr,
-                                            image.data_size(), image.data()));
+    detach_segment();
+    if (attach_segment()) {
+        xcb_image.reset();
+    } else {
+        // xcb only reads from the data of native images, the buffer may be shared with other windows
+        auto *pixels = const_cast<unsigned char *>(image->pixels.data()); // NOLINT
+        xcb_image.reset(xcb_image_create_native(x11.connection.get(), image->width, image->height,
+                                                XCB_IMAGE_FORMAT_Z_PIXMAP, x11.screen->root_depth, nullptr,
+                                                image->pixels.size(), pixels));
+    }
     xcb_window.configure((font.width * command.x) + font.horizontal_padding,
-                         (font.height * command.y) + font.vertical_padding, image.width(), image.height());
-    x11.flush();
+                         (font.height * command.y) + font.vertical_padding, image->width, image->height);
     return {};
 }
 
+auto X11Window::attach_segment() -> bool
+{
+    auto &x11 = ctx->x11;
+    if (!x11.has_shm_fd || image->fd == -1) {
+        return false;
+    }
+    // xcb closes the fd once it is sent
+    const int segment_fd = dup(image->fd);
+    if (segment_fd == -1) {
+        return false;
+    }
+    segment = xcb_generate_id(x11.connection.get());
+    // checked, a server that can't map the fd gets the pixels over the socket instead
+    const auto cookie = xcb_shm_attach_fd_checked(x11.connection.get(), segment, segment_fd, 1);
+    if (const xcb::error err{xcb_request_check(x11.connection.get(), cookie)}) {
+        x11.handle_xcb_error(err.get());
+        segment = 0;
+        return false;
+    }
+    return true;
+}
+
+void X11Window::detach_segment()
+{
+    if (segment == 0) {
+        return;
+    }
+    xcb_shm_detach(ctx->x11.connection.get(), segment);
+    segment = 0;
+}
+
 void X11Window::draw(xcb::window_id window)
 {
     std::scoped_lock image_lock{image_mutex};
-    xcb_image_put(ctx->x11.connection.get(), window, ctx->x11.gcontext, xcb_image.get(), 0, 0, 0);
+    put_image(window);
+}
+
+void X11Window::put_image(xcb::window_id window)
+{
+    auto &x11 = ctx->x11;
+    if (segment != 0) {
+        const auto width = static_cast<std::uint16_t>(image->width);
+        const auto height = static_cast<std::uint16_t>(image->height);
+        xcb_shm_put_image(x11.connection.get(), window, x11.gcontext, width, height, 0, 0, width, height, 0, 0,
+                          x11.screen->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, segment, 0);
+        return;
+    }
+    xcb_image_put(x11.connection.get(), window, x11.gcontext, xcb_image.get(), 0, 0, 0);
 }
 
 void X11Window::hide_xcb_windows()
 {
     xcb_window.hide();
-    ctx->x11.flush();
 }
 
 } // namespace upp